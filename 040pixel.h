@@ -57,7 +57,9 @@ double pixGetB(int x, int y);
 relative to the lower left corner of the window. */
 void pixSetRGB(int x, int y, double red, double green, double blue);
 
-/* Sets all pixels to the given RGB color. */
+/* Sets all pixels to the given RGB color. In the headless pixel system, the 
+pixels are actually written only as they are next touched, so the cost does not 
+depend on the size of the window. */
 void pixClearRGB(double red, double green, double blue);
 
 /* data must be an array of width * height * 3 doubles, so that it can hold RGB 
@@ -140,3 +142,213 @@ current frame. Both times are in seconds since the epoch (something like 1970).
 void pixSetTimeStepHandler(void (*handler)(double, double));
 
 
+
+/*** Headless ***/
+
+/* The functions in this section are implemented only by 040pixelHeadless.c, 
+which can replace 040pixel.o on machines without a display. There the window is 
+an array in memory and pixRun is a loop that invokes the time step callback, 
+with no user interface events. Programs that call these functions cannot be 
+linked against 040pixel.o. */
+
+/* Makes pixRun return after frameCount frames. Zero or less means no limit. 
+This overrides the PIXFRAMES environment variable, which is read by 
+pixInitialize. */
+void pixSetFrameCount(int frameCount);
+
+/* Makes pixRun return once the given number of seconds have elapsed. Zero or 
+less means no limit. This overrides the PIXSECONDS environment variable, which 
+is read by pixInitialize. If neither a count nor a duration is set, then pixRun 
+runs a single frame. */
+void pixSetFrameDuration(double seconds);
+
+
+
+/*** Direct access ***/
+
+/* These functions are also implemented only by 040pixelHeadless.c. They let 
+rasterizers and post-processing code write many pixels per call, rather than 
+paying for one pixSetRGB call per pixel. */
+
+/* Returns a pointer to the window's colors, and sets *stride to the number of 
+doubles between the starts of consecutive rows. Pixel (x, y) (measured from 
+the lower left) is at data[y * stride + x * 3] and the two doubles following 
+that. The pointer may be read and written until pixUnlockRGB is called. Do not 
+call other pixel system functions in between. */
+double *pixLockRGB(int *stride);
+
+/* Ends the access begun by pixLockRGB, and marks the whole window as dirty 
+(see pixGetDirtyTiles). */
+void pixUnlockRGB(void);
+
+/* Like pixUnlockRGB, but marks only the rectangle x0 <= x <= x1, 
+y0 <= y <= y1 as dirty. Use it when the writes were confined to that 
+rectangle. */
+void pixUnlockRGBRect(int x0, int y0, int x1, int y1);
+
+/* Sets pixels x0 through x1 (inclusive) of row y. rgb must hold 
+(x1 - x0 + 1) * 3 doubles, with the color of pixel (x, y) at rgb[(x - x0) * 3] 
+and the two doubles following that. Pixels outside the window are ignored. */
+void pixSetRGBSpan(int x0, int x1, int y, const double rgb[]);
+
+/* Sets every pixel (x, y) with x0 <= x <= x1 and y0 <= y <= y1 to the given 
+RGB color. The rectangle is clipped to the window. */
+void pixFillRect(
+        int x0, int y0, int x1, int y1, double red, double green, 
+        double blue);
+
+
+
+/*** Packed formats ***/
+
+/* These functions are also implemented only by 040pixelHeadless.c. A packed 
+window stores each pixel in 32 bits rather than three doubles, so that reading 
+back frames for capture or compositing moves a sixth as many bytes. In 
+pixRGBA8, red is in bits 0-7, green in bits 8-15, blue in bits 16-23, and alpha 
+(always opaque) in bits 24-31. In pixRGB10A2, red, green, and blue take 10 bits 
+each, starting at bits 0, 10, and 20, and alpha takes bits 30-31. Colors passed 
+as doubles are clamped to [0, 1] and rounded. */
+
+#include <stdint.h>
+
+#define pixDOUBLE 0
+#define pixRGBA8 1
+#define pixRGB10A2 2
+
+/* Like pixInitialize, but with the window stored in the given format: 
+pixDOUBLE, pixRGBA8, or pixRGB10A2. pixInitialize uses pixDOUBLE. */
+int pixInitializeFormat(int width, int height, const char *name, int format);
+
+/* Returns the format that the window was initialized with. */
+int pixGetFormat(void);
+
+/* Like pixLockRGB, but for packed windows. Pixel (x, y) is at 
+data[y * stride + x]. Returns NULL if the window is pixDOUBLE. Finish with 
+pixUnlockRGB. Likewise pixLockRGB returns NULL if the window is packed. */
+uint32_t *pixLockPacked(int *stride);
+
+/* Like pixCopyRGB, but data must be an array of width * height packed colors, 
+and no conversion takes place. Works only on packed windows. */
+void pixCopyPacked(uint32_t *data);
+
+/* Inverse of pixCopyPacked. */
+void pixPastePacked(const uint32_t *data);
+
+
+
+/*** Presentation ***/
+
+/* These functions are also implemented only by 040pixelHeadless.c. By 
+default, the window is simply drawn into, and nothing is presented. After 
+pixSetPresentBuffers, each frame that the time step callback draws is 
+presented, by copying it to a front buffer that stands in for the screen. With 
+one buffer, the copy happens synchronously at the end of each frame. With two 
+or three, the frame is handed to a present thread, and the next frame is drawn 
+into another buffer meanwhile. That buffer holds an older frame, so the time 
+step callback should redraw the whole window, as render functions that start 
+with pixClearRGB do. Each submitted frame is numbered by a fence, starting at 
+1, and pixRun waits for all of its frames to be presented before returning. */
+
+/* Sets the number of buffers: 0 (the default), 1, 2, or 3. Returns an error 
+code, which is 0 if no error occurred. Call it after pixInitialize and outside 
+pixRun. The current contents of the window are kept. */
+int pixSetPresentBuffers(int count);
+
+/* Registers a function that pixRun calls at the end of each frame, after the 
+time step callback and before the frame is captured or presented, such as a 
+resolve of a multisampled image into the window. It is called even when there 
+are no present buffers. Pass NULL to stop. */
+void pixSetPresentHandler(void (*handler)(void));
+
+/* Limits how many submitted frames may be waiting for presentation while the 
+next frame is drawn. The limit is at least 1 and at most the number of buffers 
+minus 1, which is also the default. A limit of 1 with three buffers trades 
+throughput for lower latency. */
+void pixSetFramesInFlight(int limit);
+
+/* Returns the fence of the most recently submitted frame, or 0 if there is 
+none. */
+long pixGetFrameFence(void);
+
+/* Waits until the frame with the given fence (and all earlier frames) has been 
+presented. */
+void pixWaitFence(long fence);
+
+/* Like pixCopyRGB, but copies the most recently presented frame, rather than 
+the frame being drawn. Without presentation, it is the same as pixCopyRGB. */
+void pixCopyPresentedRGB(double *data);
+
+
+
+/*** Dirty tracking ***/
+
+/* These functions are also implemented only by 040pixelHeadless.c. The window 
+is divided into tiles of pixTILESIZE x pixTILESIZE pixels (smaller along the 
+right and top edges), numbered col + colNum * row from the lower left. A tile 
+is dirty in a frame if any function wrote to it during that frame. pixPasteRGB 
+marks only the tiles whose contents actually change. Presentation copies only 
+dirty tiles. The functions below describe the most recently completed frame, 
+which makes them suitable for sending only the changes of each frame. */
+
+#define pixTILESIZE 32
+
+/* Sets *colNum and *rowNum to the number of tile columns and rows. */
+void pixGetTileGrid(int *colNum, int *rowNum);
+
+/* Fills dirty, which must hold colNum * rowNum entries, with 1 for each dirty 
+tile and 0 for each other tile. Returns the number of dirty tiles. */
+int pixGetDirtyTiles(unsigned char dirty[]);
+
+/* Sets the rectangle x0 <= x <= x1, y0 <= y <= y1 to the bounding box of the 
+dirty tiles, and returns 1. If no tile is dirty, returns 0 instead. */
+int pixGetDirtyRect(int *x0, int *y0, int *x1, int *y1);
+
+
+
+/*** Tracing ***/
+
+/* This function is also implemented only by 040pixelHeadless.c. It registers 
+functions that pixRun calls to mark spans of its work for a profiler, such as 
+traceBegin and traceEnd of 390trace.c. pixRun marks each frame, and within the 
+frame the time step callback and the presentation, and finally the wait for the 
+last frame to be presented. Pass NULL for both to stop. The handlers are called 
+only from the thread that called pixRun. */
+void pixSetTraceHandlers(void (*begin)(const char *), void (*end)(void));
+
+
+
+/*** Capture ***/
+
+/* These functions are also implemented only by 040pixelHeadless.c. While 
+capturing, the end of every frame copies the window into one of slotNum 
+preallocated slots, and workerNum threads encode the slots in the background. 
+Frames are numbered from 0 in the order that they are drawn. If every slot is 
+still waiting to be encoded, then pixCAPTUREWAIT makes the frame wait for a 
+slot, while pixCAPTUREDROP skips the frame (leaving a gap in the numbering). 
+Either way, pixGetCaptureStats accounts for it. */
+
+#define pixCAPTUREPPM 0
+#define pixCAPTUREPNG 1
+#define pixCAPTURERAW 2
+#define pixCAPTUREWAIT 0
+#define pixCAPTUREDROP 1
+
+/* Starts capturing. For pixCAPTUREPPM and pixCAPTUREPNG, path is a printf 
+format with one long conversion for the frame number, such as 
+"frames/landscape%05ld.png", and each frame goes to its own file. For 
+pixCAPTURERAW, path names a single file, which receives the frames as 
+consecutive 8-bit RGB images with the top row first. At most 64 slots and 64 
+workers are allowed. Returns an error code, which is 0 if no error occurred. */
+int pixStartCapture(
+        const char *path, int format, int slotNum, int workerNum, 
+        int policy);
+
+/* Waits until all captured frames have been encoded, and stops capturing. 
+pixFinalize calls it automatically. */
+void pixStopCapture(void);
+
+/* Reports the number of frames copied into slots, the number dropped for lack 
+of a slot, the number successfully written, and the total time in seconds that 
+frames have spent waiting for a slot. */
+void pixGetCaptureStats(
+        long *snapshotNum, long *dropNum, long *writeNum, double *waitTime);
@@ -0,0 +1,1334 @@
+
+
+
+/* This file is a second implementation of the pixel system declared in
+040pixel.h. Unlike 040pixel.o, it needs neither GLFW nor OpenGL nor a display.
+The window is just an array of doubles in memory, and pixRun is a plain frame
+loop that invokes the time step callback a fixed number of times or for a fixed
+amount of time. That makes it suitable for build machines, render farms, and
+performance measurement. Compile it alongside a main program instead of linking
+040pixel.o. For example, on Ubuntu...
+    cc 340mainLandscape.c 040pixelHeadless.c -lm -lpthread
+The main programs still include GLFW/glfw3.h for its key constants, so the GLFW
+header must be present, but the GLFW library is not linked.
+
+The window can hold doubles, as in 040pixel.o, or packed 8-bit or 10-bit 
+colors (see pixInitializeFormat). Packed windows use a quarter or less of the 
+memory, and conversion from doubles happens in batches, using SSE2 where the 
+compiler offers it.
+
+By default, the window is all there is. Alternatively, pixSetPresentBuffers 
+makes each frame be presented to a separate front buffer, which stands in for 
+the screen. With two or three buffers, the presentation happens on a dedicated 
+thread, while the next frame is rendered into another buffer. Either way, 
+pixSetPresentHandler can finish each frame just before it is presented, for 
+example by resolving a multisampled image into the window.
+
+pixClearRGB is lazy. It records the clear color and increments the back 
+buffer's epoch, which makes every tile stale. A stale tile reads as the clear 
+color, and it is filled with that color only when something is written to it. 
+Presentation fills the stale tiles of the front buffer directly.
+
+Every write marks the pixTILESIZE x pixTILESIZE tiles that it touches as 
+dirty. Presentation copies only the dirty tiles, and the dirty region of the 
+most recent frame can be queried, for example to stream only the changes. 
+
+pixStartCapture records every frame to image files. At the end of each frame 
+the window is copied into one of a ring of preallocated slots, and a pool of 
+worker threads encodes the slots in the background.
+
+pixSetTraceHandlers lets a profiler such as 390trace.c see the frame loop.
+
+The frame loop is configured with pixSetFrameCount and pixSetFrameDuration, or
+without touching the program through the PIXFRAMES and PIXSECONDS environment
+variables. If none of those is set, then pixRun runs a single frame. */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "040pixel.h"
+
+
+
+/*** Private ***/
+
+static int pixWidth = 0, pixHeight = 0, pixFormat = pixDOUBLE;
+static double *pixColors = NULL;	/* pixWidth * pixHeight * 3 doubles */
+static uint32_t *pixPacked = NULL;	/* pixWidth * pixHeight packed colors */
+static int pixFrameCount = 0;
+static double pixFrameDuration = 0.0;
+static int pixLocked = 0;
+
+/* Presentation. pixColors or pixPacked points at the back buffer, which is one 
+of the pixBufferNum buffers. When pixBufferNum is 0, there is only one buffer 
+and nothing is presented. Fences count submitted frames, starting at 1. */
+static int pixBufferNum = 0, pixBack = 0, pixInFlightLimit = 1;
+static void *pixBuffers[3] = {NULL, NULL, NULL};
+static long pixBufferFences[3] = {0, 0, 0};
+static void *pixFront = NULL;
+static long pixSubmitted = 0, pixPresented = 0;
+static int pixPresenterRunning = 0, pixPresenterQuitting = 0;
+static pthread_t pixPresenter;
+static pthread_mutex_t pixMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t pixFrontMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pixCond = PTHREAD_COND_INITIALIZER;
+
+/* Dirty tracking. Each buffer has a flag per tile, set when the tile is written 
+during the frame that the buffer holds. pixLastDirty holds the flags of the 
+most recently completed frame. */
+static int pixTileColNum = 0, pixTileRowNum = 0;
+static unsigned char *pixDirty[3] = {NULL, NULL, NULL};
+static unsigned char *pixLastDirty = NULL;
+
+/* Lazy clearing. Each buffer has an epoch, a clear color, and an epoch per 
+tile. A tile is stale when its epoch differs from its buffer's epoch. */
+static unsigned int *pixTileEpochs[3] = {NULL, NULL, NULL};
+static unsigned int pixEpochs[3] = {0, 0, 0};
+static double pixClearColors[3][3];
+static uint32_t pixClearPacked[3];
+
+/* Capture. Each slot is free, filled (waiting for a worker), or being encoded. 
+Filled slots are encoded in the order of their frame numbers. */
+#define pixSLOTFREE 0
+#define pixSLOTFILLED 1
+#define pixSLOTENCODING 2
+#define pixCAPTUREMAX 64
+static int pixCapturing = 0, pixCaptureFormat, pixCapturePolicy;
+static int pixSlotNum = 0, pixWorkerNum = 0, pixWorkersQuitting = 0;
+static char pixCapturePath[1024];
+static void *pixSlots[pixCAPTUREMAX];
+static int pixSlotStates[pixCAPTUREMAX], pixSlotFormats[pixCAPTUREMAX];
+static long pixSlotFrames[pixCAPTUREMAX];
+static long pixCaptureFrame = 0, pixSnapshotNum = 0, pixDropNum = 0;
+static long pixWriteNum = 0;
+static double pixCaptureWait = 0.0;
+static int pixRawFile = -1;
+static pthread_t pixWorkers[pixCAPTUREMAX];
+static pthread_mutex_t pixCaptureMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pixCaptureCond = PTHREAD_COND_INITIALIZER;
+
+static void (*pixKeyDownHandler)(int, int, int, int, int) = NULL;
+static void (*pixKeyUpHandler)(int, int, int, int, int) = NULL;
+static void (*pixKeyRepeatHandler)(int, int, int, int, int) = NULL;
+static void (*pixMouseDownHandler)(double, double, int, int, int, int, int) =
+    NULL;
+static void (*pixMouseUpHandler)(double, double, int, int, int, int, int) =
+    NULL;
+static void (*pixMouseMoveHandler)(double, double) = NULL;
+static void (*pixMouseScrollHandler)(double, double) = NULL;
+static void (*pixTimeStepHandler)(double, double) = NULL;
+static void (*pixPresentHandler)(void) = NULL;
+static void (*pixTraceBeginHandler)(const char *) = NULL;
+static void (*pixTraceEndHandler)(void) = NULL;
+
+/* Returns the time in seconds since the epoch, as the time step callback of
+040pixel.o expects. */
+static double pixTime(void) {
+    struct timespec spec;
+    clock_gettime(CLOCK_REALTIME, &spec);
+    return spec.tv_sec + spec.tv_nsec * 0.000000001;
+}
+
+/* Returns a monotonic time in seconds, for measuring durations. */
+static double pixClock(void) {
+    struct timespec spec;
+    clock_gettime(CLOCK_MONOTONIC, &spec);
+    return spec.tv_sec + spec.tv_nsec * 0.000000001;
+}
+
+
+
+/* The largest level of a channel in each packed format. */
+#define pixSCALE8 255.0
+#define pixSCALE10 1023.0
+
+/* Converts count colors, given as 3 * count doubles, to the packed format. 
+Each channel is clamped to [0, 1] and rounded to the nearest level. */
+static void pixPackSpan(int count, const double rgb[], uint32_t packed[]) {
+    double scale = (pixFormat == pixRGBA8) ? pixSCALE8 : pixSCALE10;
+    int levels[3 * 64];
+    int done, batch, k;
+    for (done = 0; done < count; done += batch) {
+        batch = (count - done < 64) ? count - done : 64;
+        const double *in = &rgb[3 * done];
+        int n = 3 * batch;
+        k = 0;
+#if defined(__SSE2__)
+        __m128d zero = _mm_setzero_pd(), one = _mm_set1_pd(1.0);
+        __m128d scaleV = _mm_set1_pd(scale), half = _mm_set1_pd(0.5);
+        for (; k + 4 <= n; k += 4) {
+            __m128d c0 = _mm_loadu_pd(&in[k]), c1 = _mm_loadu_pd(&in[k + 2]);
+            c0 = _mm_min_pd(_mm_max_pd(c0, zero), one);
+            c1 = _mm_min_pd(_mm_max_pd(c1, zero), one);
+            c0 = _mm_add_pd(_mm_mul_pd(c0, scaleV), half);
+            c1 = _mm_add_pd(_mm_mul_pd(c1, scaleV), half);
+            __m128i i0 = _mm_cvttpd_epi32(c0), i1 = _mm_cvttpd_epi32(c1);
+            _mm_storeu_si128((__m128i *)&levels[k], 
+                _mm_unpacklo_epi64(i0, i1));
+        }
+#endif
+        for (; k < n; k += 1) {
+            double c = in[k];
+            c = (c < 0.0) ? 0.0 : ((c > 1.0) ? 1.0 : c);
+            levels[k] = (int)(c * scale + 0.5);
+        }
+        if (pixFormat == pixRGBA8)
+            for (k = 0; k < batch; k += 1)
+                packed[done + k] = (uint32_t)levels[3 * k] | 
+                    ((uint32_t)levels[3 * k + 1] << 8) | 
+                    ((uint32_t)levels[3 * k + 2] << 16) | 0xFF000000u;
+        else
+            for (k = 0; k < batch; k += 1)
+                packed[done + k] = (uint32_t)levels[3 * k] | 
+                    ((uint32_t)levels[3 * k + 1] << 10) | 
+                    ((uint32_t)levels[3 * k + 2] << 20) | 0xC0000000u;
+    }
+}
+
+/* Inverse of pixPackSpan, except for the rounding. */
+static void pixUnpackSpan(int count, const uint32_t packed[], double rgb[]) {
+    int k;
+    if (pixFormat == pixRGBA8)
+        for (k = 0; k < count; k += 1) {
+            rgb[3 * k] = (packed[k] & 0xFF) / pixSCALE8;
+            rgb[3 * k + 1] = ((packed[k] >> 8) & 0xFF) / pixSCALE8;
+            rgb[3 * k + 2] = ((packed[k] >> 16) & 0xFF) / pixSCALE8;
+        }
+    else
+        for (k = 0; k < count; k += 1) {
+            rgb[3 * k] = (packed[k] & 0x3FF) / pixSCALE10;
+            rgb[3 * k + 1] = ((packed[k] >> 10) & 0x3FF) / pixSCALE10;
+            rgb[3 * k + 2] = ((packed[k] >> 20) & 0x3FF) / pixSCALE10;
+        }
+}
+
+/* Returns the given channel of pixel (x, y), which must be in the window. */
+static double pixGetChannel(int x, int y, int channel) {
+    int tile = x / pixTILESIZE + pixTileColNum * (y / pixTILESIZE);
+    if (pixTileEpochs[pixBack][tile] != pixEpochs[pixBack]) {
+        if (pixFormat == pixDOUBLE)
+            return pixClearColors[pixBack][channel];
+        double rgb[3];
+        pixUnpackSpan(1, &pixClearPacked[pixBack], rgb);
+        return rgb[channel];
+    }
+    if (pixFormat == pixDOUBLE)
+        return pixColors[(x + pixWidth * y) * 3 + channel];
+    double rgb[3];
+    pixUnpackSpan(1, &pixPacked[x + pixWidth * y], rgb);
+    return rgb[channel];
+}
+
+
+
+/* Returns the number of bytes in one buffer. */
+static size_t pixBufferSize(void) {
+    if (pixFormat == pixDOUBLE)
+        return (size_t)pixWidth * pixHeight * 3 * sizeof(double);
+    return (size_t)pixWidth * pixHeight * sizeof(uint32_t);
+}
+
+/* Makes the given buffer the back buffer. */
+static void pixSelectBuffer(int buffer) {
+    pixBack = buffer;
+    if (pixFormat == pixDOUBLE)
+        pixColors = (double *)pixBuffers[buffer];
+    else
+        pixPacked = (uint32_t *)pixBuffers[buffer];
+}
+
+/* Writes the given buffer's clear color into the given tile of data, which is 
+a buffer-sized array. */
+static void pixFillTile(void *data, int buffer, int tile) {
+    int x0 = (tile % pixTileColNum) * pixTILESIZE;
+    int y0 = (tile / pixTileColNum) * pixTILESIZE;
+    int x1 = (x0 + pixTILESIZE < pixWidth) ? x0 + pixTILESIZE : pixWidth;
+    int y1 = (y0 + pixTILESIZE < pixHeight) ? y0 + pixTILESIZE : pixHeight;
+    int x, y;
+    for (y = y0; y < y1; y += 1)
+        if (pixFormat == pixDOUBLE) {
+            double *row = &((double *)data)[(x0 + (size_t)pixWidth * y) * 3];
+            for (x = 0; x < x1 - x0; x += 1) {
+                row[x * 3] = pixClearColors[buffer][0];
+                row[x * 3 + 1] = pixClearColors[buffer][1];
+                row[x * 3 + 2] = pixClearColors[buffer][2];
+            }
+        } else {
+            uint32_t *row = &((uint32_t *)data)[x0 + (size_t)pixWidth * y];
+            for (x = 0; x < x1 - x0; x += 1)
+                row[x] = pixClearPacked[buffer];
+        }
+}
+
+/* If the given tile of the back buffer is stale, then fills it with the clear 
+color, so that it can be written. */
+static void pixRealizeTile(int tile) {
+    if (pixTileEpochs[pixBack][tile] != pixEpochs[pixBack]) {
+        pixFillTile(pixBuffers[pixBack], pixBack, tile);
+        pixTileEpochs[pixBack][tile] = pixEpochs[pixBack];
+    }
+}
+
+/* Realizes every tile of the back buffer overlapping the rectangle 
+x0 <= x <= x1, y0 <= y <= y1, which must lie within the window. */
+static void pixRealizeRect(int x0, int y0, int x1, int y1) {
+    int col, row;
+    for (row = y0 / pixTILESIZE; row <= y1 / pixTILESIZE; row += 1)
+        for (col = x0 / pixTILESIZE; col <= x1 / pixTILESIZE; col += 1)
+            pixRealizeTile(col + pixTileColNum * row);
+}
+
+/* Exchanges buffers a and b, along with their dirty flags and clear state. */
+static void pixSwapBuffers(int a, int b) {
+    void *buffer = pixBuffers[a];
+    unsigned char *dirty = pixDirty[a];
+    unsigned int *tileEpochs = pixTileEpochs[a], epoch = pixEpochs[a];
+    uint32_t packed = pixClearPacked[a];
+    double color[3] = {pixClearColors[a][0], pixClearColors[a][1], 
+        pixClearColors[a][2]};
+    pixBuffers[a] = pixBuffers[b];
+    pixDirty[a] = pixDirty[b];
+    pixTileEpochs[a] = pixTileEpochs[b];
+    pixEpochs[a] = pixEpochs[b];
+    pixClearPacked[a] = pixClearPacked[b];
+    memcpy(pixClearColors[a], pixClearColors[b], 3 * sizeof(double));
+    pixBuffers[b] = buffer;
+    pixDirty[b] = dirty;
+    pixTileEpochs[b] = tileEpochs;
+    pixEpochs[b] = epoch;
+    pixClearPacked[b] = packed;
+    memcpy(pixClearColors[b], color, 3 * sizeof(double));
+}
+
+/* Marks the tiles overlapping the rectangle x0 <= x <= x1, y0 <= y <= y1 as 
+dirty. The rectangle must lie within the window. */
+static void pixMarkDirty(int x0, int y0, int x1, int y1) {
+    int col, row;
+    unsigned char *dirty = pixDirty[pixBack];
+    for (row = y0 / pixTILESIZE; row <= y1 / pixTILESIZE; row += 1)
+        for (col = x0 / pixTILESIZE; col <= x1 / pixTILESIZE; col += 1)
+            dirty[col + pixTileColNum * row] = 1;
+}
+
+/* Copies the dirty tiles of the given buffer to the front buffer. This is the 
+upload that a windowed pixel system would make. Stale tiles are not copied; the 
+clear color is written to the front buffer instead. */
+static void pixUpload(int buffer) {
+    size_t pixelSize = pixBufferSize() / ((size_t)pixWidth * pixHeight);
+    char *from = (char *)pixBuffers[buffer], *to = (char *)pixFront;
+    const unsigned char *dirty = pixDirty[buffer];
+    const unsigned int *epochs = pixTileEpochs[buffer];
+    unsigned int epoch = pixEpochs[buffer];
+    int col, row, x0, y0, width, y, yBound, tile;
+    pthread_mutex_lock(&pixFrontMutex);
+    for (row = 0; row < pixTileRowNum; row += 1)
+        for (col = 0; col < pixTileColNum; col += 1) {
+            tile = col + pixTileColNum * row;
+            if (!dirty[tile])
+                continue;
+            if (epochs[tile] != epoch) {
+                pixFillTile(pixFront, buffer, tile);
+                continue;
+            }
+            /* Merge runs of dirty, realized tiles within the row into one 
+            copy. */
+            x0 = col * pixTILESIZE;
+            while (col + 1 < pixTileColNum && dirty[tile + 1] && 
+                    epochs[tile + 1] == epoch) {
+                col += 1;
+                tile += 1;
+            }
+            width = (col + 1) * pixTILESIZE;
+            width = ((width < pixWidth) ? width : pixWidth) - x0;
+            y0 = row * pixTILESIZE;
+            yBound = (y0 + pixTILESIZE < pixHeight) ? y0 + pixTILESIZE : 
+                pixHeight;
+            for (y = y0; y < yBound; y += 1)
+                memcpy(&to[(x0 + (size_t)pixWidth * y) * pixelSize], 
+                    &from[(x0 + (size_t)pixWidth * y) * pixelSize], 
+                    width * pixelSize);
+        }
+    pthread_mutex_unlock(&pixFrontMutex);
+}
+
+/* Ends the frame held by the back buffer, as far as dirty tracking goes. */
+static void pixEndDirtyFrame(void) {
+    memcpy(pixLastDirty, pixDirty[pixBack], pixTileColNum * pixTileRowNum);
+}
+
+/* Body of the present thread. Presents submitted frames in order. */
+static void *pixPresentLoop(void *unused) {
+    int buffer;
+    long fence;
+    pthread_mutex_lock(&pixMutex);
+    while (1) {
+        while (pixPresented == pixSubmitted && !pixPresenterQuitting)
+            pthread_cond_wait(&pixCond, &pixMutex);
+        if (pixPresented == pixSubmitted)
+            break;
+        fence = pixPresented + 1;
+        for (buffer = 0; pixBufferFences[buffer] != fence; buffer += 1);
+        pthread_mutex_unlock(&pixMutex);
+        pixUpload(buffer);
+        pthread_mutex_lock(&pixMutex);
+        pixPresented = fence;
+        pthread_cond_broadcast(&pixCond);
+    }
+    pthread_mutex_unlock(&pixMutex);
+    return unused;
+}
+
+/* Waits for all submitted frames to be presented, and stops the present 
+thread. */
+static void pixStopPresenter(void) {
+    if (!pixPresenterRunning)
+        return;
+    pthread_mutex_lock(&pixMutex);
+    pixPresenterQuitting = 1;
+    pthread_cond_broadcast(&pixCond);
+    pthread_mutex_unlock(&pixMutex);
+    pthread_join(pixPresenter, NULL);
+    pixPresenterRunning = 0;
+    pixPresenterQuitting = 0;
+}
+
+/* Converts a captured slot to 8-bit RGB, with the top row first, as image 
+files expect. */
+static void pixSlotToRGB8(const void *slot, int format, unsigned char *rgb) {
+    int x, y, k;
+    double color[3];
+    for (y = 0; y < pixHeight; y += 1) {
+        unsigned char *row = &rgb[(size_t)(pixHeight - 1 - y) * pixWidth * 3];
+        for (x = 0; x < pixWidth; x += 1) {
+            size_t index = x + (size_t)pixWidth * y;
+            if (format == pixDOUBLE) {
+                for (k = 0; k < 3; k += 1) {
+                    color[k] = ((const double *)slot)[index * 3 + k];
+                    color[k] = (color[k] < 0.0) ? 0.0 : 
+                        ((color[k] > 1.0) ? 1.0 : color[k]);
+                    row[x * 3 + k] = (unsigned char)(color[k] * 255.0 + 0.5);
+                }
+            } else if (format == pixRGBA8) {
+                uint32_t packed = ((const uint32_t *)slot)[index];
+                row[x * 3] = packed & 0xFF;
+                row[x * 3 + 1] = (packed >> 8) & 0xFF;
+                row[x * 3 + 2] = (packed >> 16) & 0xFF;
+            } else {
+                uint32_t packed = ((const uint32_t *)slot)[index];
+                row[x * 3] = ((packed & 0x3FF) * 255 + 511) / 1023;
+                row[x * 3 + 1] = (((packed >> 10) & 0x3FF) * 255 + 511) / 1023;
+                row[x * 3 + 2] = (((packed >> 20) & 0x3FF) * 255 + 511) / 1023;
+            }
+        }
+    }
+}
+
+/* Helpers for pixWritePNG. */
+static uint32_t pixCRCTable[256];
+static pthread_once_t pixCRCOnce = PTHREAD_ONCE_INIT;
+
+static void pixInitializeCRC(void) {
+    uint32_t c;
+    int n, k;
+    for (n = 0; n < 256; n += 1) {
+        c = (uint32_t)n;
+        for (k = 0; k < 8; k += 1)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        pixCRCTable[n] = c;
+    }
+}
+
+static uint32_t pixCRC(uint32_t crc, const unsigned char *data, size_t size) {
+    size_t i;
+    for (i = 0; i < size; i += 1)
+        crc = pixCRCTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+static void pixPutBigEndian(unsigned char *data, uint32_t value) {
+    data[0] = value >> 24;
+    data[1] = value >> 16;
+    data[2] = value >> 8;
+    data[3] = value;
+}
+
+/* Writes one PNG chunk. data holds the 4-byte type followed by size bytes. */
+static void pixWriteChunk(FILE *file, const unsigned char *data, size_t size) {
+    unsigned char number[4];
+    pixPutBigEndian(number, (uint32_t)size);
+    fwrite(number, 1, 4, file);
+    fwrite(data, 1, size + 4, file);
+    pixPutBigEndian(number, pixCRC(0xFFFFFFFFu, data, size + 4) ^ 0xFFFFFFFFu);
+    fwrite(number, 1, 4, file);
+}
+
+/* Writes 8-bit RGB (top row first) as a PNG file. To stay free of 
+dependencies, the image data are stored in uncompressed deflate blocks. Returns 
+0 on success. */
+static int pixWritePNG(FILE *file, const unsigned char *rgb) {
+    static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    size_t rowSize = (size_t)pixWidth * 3 + 1;
+    size_t rawSize = rowSize * pixHeight;
+    size_t blockNum = (rawSize + 65534) / 65535;
+    size_t dataSize = 2 + rawSize + 5 * blockNum + 4;
+    unsigned char *chunk = (unsigned char *)malloc(4 + dataSize);
+    if (chunk == NULL)
+        return 1;
+    pthread_once(&pixCRCOnce, pixInitializeCRC);
+    fwrite(signature, 1, 8, file);
+    unsigned char header[4 + 13] = {'I', 'H', 'D', 'R'};
+    pixPutBigEndian(&header[4], pixWidth);
+    pixPutBigEndian(&header[8], pixHeight);
+    header[12] = 8;     /* bit depth */
+    header[13] = 2;     /* RGB */
+    pixWriteChunk(file, header, 13);
+    /* Build the zlib stream, feeding the rows through stored blocks. */
+    unsigned char *out = chunk;
+    memcpy(out, "IDAT", 4);
+    out += 4;
+    *out++ = 0x78;
+    *out++ = 0x01;
+    uint32_t adlerA = 1, adlerB = 0;
+    size_t done = 0, blockSize, i;
+    while (done < rawSize) {
+        blockSize = (rawSize - done < 65535) ? rawSize - done : 65535;
+        *out++ = (done + blockSize == rawSize);
+        *out++ = blockSize & 0xFF;
+        *out++ = blockSize >> 8;
+        *out++ = ~blockSize & 0xFF;
+        *out++ = (~blockSize >> 8) & 0xFF;
+        for (i = done; i < done + blockSize; i += 1) {
+            /* Each row starts with filter type 0. */
+            size_t row = i / rowSize, column = i % rowSize;
+            *out = (column == 0) ? 0 : rgb[row * (rowSize - 1) + column - 1];
+            adlerA = (adlerA + *out) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+            out += 1;
+        }
+        done += blockSize;
+    }
+    pixPutBigEndian(out, (adlerB << 16) | adlerA);
+    pixWriteChunk(file, chunk, dataSize);
+    unsigned char end[4] = {'I', 'E', 'N', 'D'};
+    pixWriteChunk(file, end, 0);
+    free(chunk);
+    return ferror(file);
+}
+
+/* Encodes the given slot. Returns 0 on success. */
+static int pixEncodeSlot(int slot) {
+    size_t rgbSize = (size_t)pixWidth * pixHeight * 3;
+    unsigned char *rgb = (unsigned char *)malloc(rgbSize);
+    if (rgb == NULL)
+        return 1;
+    pixSlotToRGB8(pixSlots[slot], pixSlotFormats[slot], rgb);
+    int error = 0;
+    if (pixCaptureFormat == pixCAPTURERAW) {
+        if (pwrite(pixRawFile, rgb, rgbSize, 
+                (off_t)rgbSize * pixSlotFrames[slot]) != (ssize_t)rgbSize)
+            error = 2;
+    } else {
+        char path[1100];
+        snprintf(path, sizeof(path), pixCapturePath, pixSlotFrames[slot]);
+        FILE *file = fopen(path, "wb");
+        if (file == NULL)
+            error = 3;
+        else {
+            if (pixCaptureFormat == pixCAPTUREPPM) {
+                fprintf(file, "P6\n%d %d\n255\n", pixWidth, pixHeight);
+                fwrite(rgb, 1, rgbSize, file);
+                error = ferror(file);
+            } else
+                error = pixWritePNG(file, rgb);
+            if (fclose(file) != 0)
+                error = 4;
+        }
+        if (error != 0)
+            fprintf(stderr, "error: pixStartCapture: cannot write %s\n", path);
+    }
+    free(rgb);
+    return error;
+}
+
+/* Body of each capture worker. Encodes filled slots, oldest frame first. */
+static void *pixCaptureLoop(void *unused) {
+    int slot, oldest;
+    pthread_mutex_lock(&pixCaptureMutex);
+    while (1) {
+        oldest = -1;
+        for (slot = 0; slot < pixSlotNum; slot += 1)
+            if (pixSlotStates[slot] == pixSLOTFILLED && (oldest < 0 || 
+                    pixSlotFrames[slot] < pixSlotFrames[oldest]))
+                oldest = slot;
+        if (oldest < 0) {
+            if (pixWorkersQuitting)
+                break;
+            pthread_cond_wait(&pixCaptureCond, &pixCaptureMutex);
+            continue;
+        }
+        pixSlotStates[oldest] = pixSLOTENCODING;
+        pthread_mutex_unlock(&pixCaptureMutex);
+        int error = pixEncodeSlot(oldest);
+        pthread_mutex_lock(&pixCaptureMutex);
+        pixWriteNum += (error == 0);
+        pixSlotStates[oldest] = pixSLOTFREE;
+        pthread_cond_broadcast(&pixCaptureCond);
+    }
+    pthread_mutex_unlock(&pixCaptureMutex);
+    return unused;
+}
+
+/* Snapshots the back buffer into a free slot, waiting for one or dropping the 
+frame, according to the capture policy. */
+static void pixCaptureBack(void) {
+    if (!pixCapturing)
+        return;
+    int slot = -1;
+    double start = pixClock();
+    pthread_mutex_lock(&pixCaptureMutex);
+    while (1) {
+        for (slot = 0; slot < pixSlotNum; slot += 1)
+            if (pixSlotStates[slot] == pixSLOTFREE)
+                break;
+        if (slot < pixSlotNum || pixCapturePolicy == pixCAPTUREDROP)
+            break;
+        pthread_cond_wait(&pixCaptureCond, &pixCaptureMutex);
+    }
+    pixCaptureWait += pixClock() - start;
+    if (slot == pixSlotNum) {
+        pixDropNum += 1;
+        pixCaptureFrame += 1;
+        pthread_mutex_unlock(&pixCaptureMutex);
+        return;
+    }
+    pixSlotStates[slot] = pixSLOTENCODING;
+    pthread_mutex_unlock(&pixCaptureMutex);
+    pixRealizeRect(0, 0, pixWidth - 1, pixHeight - 1);
+    memcpy(pixSlots[slot], pixBuffers[pixBack], pixBufferSize());
+    pthread_mutex_lock(&pixCaptureMutex);
+    pixSlotFormats[slot] = pixFormat;
+    pixSlotFrames[slot] = pixCaptureFrame;
+    pixSlotStates[slot] = pixSLOTFILLED;
+    pixCaptureFrame += 1;
+    pixSnapshotNum += 1;
+    pthread_cond_broadcast(&pixCaptureCond);
+    pthread_mutex_unlock(&pixCaptureMutex);
+}
+
+/* Submits the back buffer for presentation, and then makes the next buffer 
+the back buffer, waiting until it is no longer in flight. */
+static void pixPresentFrame(void) {
+    pixCaptureBack();
+    pixEndDirtyFrame();
+    if (pixBufferNum == 0) {
+        memset(pixDirty[0], 0, pixTileColNum * pixTileRowNum);
+        return;
+    }
+    if (pixBufferNum == 1) {
+        pixUpload(0);
+        memset(pixDirty[0], 0, pixTileColNum * pixTileRowNum);
+        pthread_mutex_lock(&pixMutex);
+        pixSubmitted += 1;
+        pixPresented = pixSubmitted;
+        pthread_cond_broadcast(&pixCond);
+        pthread_mutex_unlock(&pixMutex);
+        return;
+    }
+    int next = (pixBack + 1) % pixBufferNum;
+    pthread_mutex_lock(&pixMutex);
+    pixSubmitted += 1;
+    pixBufferFences[pixBack] = pixSubmitted;
+    pthread_cond_broadcast(&pixCond);
+    while (pixPresented < pixBufferFences[next] || 
+            pixSubmitted - pixPresented > pixInFlightLimit)
+        pthread_cond_wait(&pixCond, &pixMutex);
+    pthread_mutex_unlock(&pixMutex);
+    pixSelectBuffer(next);
+    memset(pixDirty[next], 0, pixTileColNum * pixTileRowNum);
+}
+
+
+
+/*** Miscellaneous ***/
+
+int pixInitialize(int width, int height, const char *name) {
+    return pixInitializeFormat(width, height, name, pixDOUBLE);
+}
+
+int pixInitializeFormat(int width, int height, const char *name, int format) {
+    /* There is no window to title. */
+    (void)name;
+    if (pixColors != NULL || pixPacked != NULL) {
+        fprintf(stderr, "error: pixInitialize: already initialized\n");
+        return 1;
+    }
+    if (width <= 0 || height <= 0) {
+        fprintf(stderr, "error: pixInitialize: bad size %d x %d\n", width,
+            height);
+        return 2;
+    }
+    if (format == pixDOUBLE)
+        pixColors = (double *)calloc((size_t)width * height * 3, sizeof(double));
+    else if (format == pixRGBA8 || format == pixRGB10A2)
+        pixPacked = (uint32_t *)calloc((size_t)width * height, sizeof(uint32_t));
+    else {
+        fprintf(stderr, "error: pixInitialize: bad format %d\n", format);
+        return 4;
+    }
+    if (pixColors == NULL && pixPacked == NULL) {
+        fprintf(stderr, "error: pixInitialize: malloc failed\n");
+        return 3;
+    }
+    pixFormat = format;
+    pixWidth = width;
+    pixHeight = height;
+    pixBuffers[0] = (format == pixDOUBLE) ? (void *)pixColors : 
+        (void *)pixPacked;
+    pixTileColNum = (width + pixTILESIZE - 1) / pixTILESIZE;
+    pixTileRowNum = (height + pixTILESIZE - 1) / pixTILESIZE;
+    pixDirty[0] = (unsigned char *)calloc(pixTileColNum * pixTileRowNum, 1);
+    pixLastDirty = (unsigned char *)calloc(pixTileColNum * pixTileRowNum, 1);
+    pixTileEpochs[0] = (unsigned int *)calloc(pixTileColNum * pixTileRowNum, 
+        sizeof(unsigned int));
+    pixEpochs[0] = 0;
+    if (pixDirty[0] == NULL || pixLastDirty == NULL || 
+            pixTileEpochs[0] == NULL) {
+        fprintf(stderr, "error: pixInitialize: malloc failed\n");
+        pixFinalize();
+        return 3;
+    }
+    const char *frames = getenv("PIXFRAMES");
+    if (frames != NULL)
+        pixFrameCount = atoi(frames);
+    const char *seconds = getenv("PIXSECONDS");
+    if (seconds != NULL)
+        pixFrameDuration = atof(seconds);
+    return 0;
+}
+
+/* Marks the beginning and end of a span of work, if tracing is on. */
+static void pixTraceBegin(const char *name) {
+    if (pixTraceBeginHandler != NULL)
+        pixTraceBeginHandler(name);
+}
+
+static void pixTraceEnd(void) {
+    if (pixTraceEndHandler != NULL)
+        pixTraceEndHandler();
+}
+
+void pixSetTraceHandlers(void (*begin)(const char *), void (*end)(void)) {
+    pixTraceBeginHandler = begin;
+    pixTraceEndHandler = end;
+}
+
+void pixRun(void) {
+    int frameCount = pixFrameCount;
+    if (frameCount <= 0 && pixFrameDuration <= 0.0)
+        frameCount = 1;
+    double start = pixClock();
+    double oldTime = pixTime(), newTime;
+    int frame = 0;
+    while (frameCount <= 0 || frame < frameCount) {
+        if (pixFrameDuration > 0.0 && pixClock() - start >= pixFrameDuration)
+            break;
+        newTime = pixTime();
+        pixTraceBegin("frame");
+        pixTraceBegin("timeStep");
+        if (pixTimeStepHandler != NULL)
+            pixTimeStepHandler(oldTime, newTime);
+        pixTraceEnd();
+        pixTraceBegin("present");
+        if (pixPresentHandler != NULL)
+            pixPresentHandler();
+        pixPresentFrame();
+        pixTraceEnd();
+        pixTraceEnd();
+        oldTime = newTime;
+        frame += 1;
+    }
+    pixTraceBegin("waitFence");
+    pixWaitFence(pixGetFrameFence());
+    pixTraceEnd();
+}
+
+void pixFinalize(void) {
+    int buffer;
+    pixStopCapture();
+    pixStopPresenter();
+    for (buffer = 0; buffer < 3; buffer += 1) {
+        free(pixBuffers[buffer]);
+        pixBuffers[buffer] = NULL;
+        pixBufferFences[buffer] = 0;
+        free(pixDirty[buffer]);
+        pixDirty[buffer] = NULL;
+        free(pixTileEpochs[buffer]);
+        pixTileEpochs[buffer] = NULL;
+        pixEpochs[buffer] = 0;
+    }
+    free(pixLastDirty);
+    pixLastDirty = NULL;
+    free(pixFront);
+    pixFront = NULL;
+    pixBufferNum = 0;
+    pixBack = 0;
+    pixSubmitted = 0;
+    pixPresented = 0;
+    pixColors = NULL;
+    pixPacked = NULL;
+    pixFormat = pixDOUBLE;
+    pixWidth = 0;
+    pixHeight = 0;
+    pixKeyDownHandler = NULL;
+    pixKeyUpHandler = NULL;
+    pixKeyRepeatHandler = NULL;
+    pixMouseDownHandler = NULL;
+    pixMouseUpHandler = NULL;
+    pixMouseMoveHandler = NULL;
+    pixMouseScrollHandler = NULL;
+    pixTimeStepHandler = NULL;
+    pixPresentHandler = NULL;
+    pixTraceBeginHandler = NULL;
+    pixTraceEndHandler = NULL;
+}
+
+double pixGetR(int x, int y) {
+    if (0 <= x && x < pixWidth && 0 <= y && y < pixHeight)
+        return pixGetChannel(x, y, 0);
+    return 0.0;
+}
+
+double pixGetG(int x, int y) {
+    if (0 <= x && x < pixWidth && 0 <= y && y < pixHeight)
+        return pixGetChannel(x, y, 1);
+    return 0.0;
+}
+
+double pixGetB(int x, int y) {
+    if (0 <= x && x < pixWidth && 0 <= y && y < pixHeight)
+        return pixGetChannel(x, y, 2);
+    return 0.0;
+}
+
+void pixSetRGB(int x, int y, double red, double green, double blue) {
+    if (0 <= x && x < pixWidth && 0 <= y && y < pixHeight) {
+        pixRealizeTile(x / pixTILESIZE + pixTileColNum * (y / pixTILESIZE));
+        if (pixFormat == pixDOUBLE) {
+            double *color = &pixColors[(x + pixWidth * y) * 3];
+            color[0] = red;
+            color[1] = green;
+            color[2] = blue;
+        } else {
+            double rgb[3] = {red, green, blue};
+            pixPackSpan(1, rgb, &pixPacked[x + pixWidth * y]);
+        }
+        pixDirty[pixBack][x / pixTILESIZE + pixTileColNum * (y / pixTILESIZE)] 
+            = 1;
+    }
+}
+
+void pixClearRGB(double red, double green, double blue) {
+    pixClearColors[pixBack][0] = red;
+    pixClearColors[pixBack][1] = green;
+    pixClearColors[pixBack][2] = blue;
+    if (pixFormat != pixDOUBLE)
+        pixPackSpan(1, pixClearColors[pixBack], &pixClearPacked[pixBack]);
+    pixEpochs[pixBack] += 1;
+    if (pixEpochs[pixBack] == 0) {
+        /* The epoch has wrapped around. Make every tile stale again. */
+        memset(pixTileEpochs[pixBack], 0, 
+            pixTileColNum * pixTileRowNum * sizeof(unsigned int));
+        pixEpochs[pixBack] = 1;
+    }
+    pixMarkDirty(0, 0, pixWidth - 1, pixHeight - 1);
+}
+
+void pixCopyRGB(double *data) {
+    pixRealizeRect(0, 0, pixWidth - 1, pixHeight - 1);
+    if (pixFormat == pixDOUBLE)
+        memcpy(data, pixColors, 
+            (size_t)pixWidth * pixHeight * 3 * sizeof(double));
+    else
+        pixUnpackSpan(pixWidth * pixHeight, pixPacked, data);
+}
+
+/* Pastes tile by tile, so that only the tiles that actually change are marked 
+dirty. */
+void pixPasteRGB(double *data) {
+    int col, row, y, x0, width, changed;
+    uint32_t packed[pixTILESIZE];
+    for (row = 0; row < pixTileRowNum; row += 1)
+        for (col = 0; col < pixTileColNum; col += 1) {
+            x0 = col * pixTILESIZE;
+            width = (x0 + pixTILESIZE < pixWidth) ? pixTILESIZE : pixWidth - x0;
+            changed = 0;
+            pixRealizeTile(col + pixTileColNum * row);
+            for (y = row * pixTILESIZE; 
+                    y < (row + 1) * pixTILESIZE && y < pixHeight; y += 1) {
+                size_t index = x0 + (size_t)pixWidth * y;
+                if (pixFormat == pixDOUBLE) {
+                    if (memcmp(&pixColors[index * 3], &data[index * 3], 
+                            width * 3 * sizeof(double)) != 0) {
+                        memcpy(&pixColors[index * 3], &data[index * 3], 
+                            width * 3 * sizeof(double));
+                        changed = 1;
+                    }
+                } else {
+                    pixPackSpan(width, &data[index * 3], packed);
+                    if (memcmp(&pixPacked[index], packed, 
+                            width * sizeof(uint32_t)) != 0) {
+                        memcpy(&pixPacked[index], packed, 
+                            width * sizeof(uint32_t));
+                        changed = 1;
+                    }
+                }
+            }
+            if (changed)
+                pixDirty[pixBack][col + pixTileColNum * row] = 1;
+        }
+}
+
+
+
+/*** Callbacks ***/
+
+/* There are no user interface events in headless mode, so only the time step
+callback is ever invoked. The others are recorded, so that programs written for
+040pixel.o run unchanged. */
+
+void pixSetKeyDownHandler(void (*handler)(int, int, int, int, int)) {
+    pixKeyDownHandler = handler;
+}
+
+void pixSetKeyUpHandler(void (*handler)(int, int, int, int, int)) {
+    pixKeyUpHandler = handler;
+}
+
+void pixSetKeyRepeatHandler(void (*handler)(int, int, int, int, int)) {
+    pixKeyRepeatHandler = handler;
+}
+
+void pixSetMouseDownHandler(void (*handler)(double, double, int, int, int, int,
+        int)) {
+    pixMouseDownHandler = handler;
+}
+
+void pixSetMouseUpHandler(void (*handler)(double, double, int, int, int, int,
+        int)) {
+    pixMouseUpHandler = handler;
+}
+
+void pixSetMouseMoveHandler(void (*handler)(double, double)) {
+    pixMouseMoveHandler = handler;
+}
+
+void pixSetMouseScrollHandler(void (*handler)(double, double)) {
+    pixMouseScrollHandler = handler;
+}
+
+void pixSetTimeStepHandler(void (*handler)(double, double)) {
+    pixTimeStepHandler = handler;
+}
+
+
+
+/*** Headless ***/
+
+void pixSetFrameCount(int frameCount) {
+    pixFrameCount = frameCount;
+}
+
+void pixSetFrameDuration(double seconds) {
+    pixFrameDuration = seconds;
+}
+
+
+
+/*** Direct access ***/
+
+double *pixLockRGB(int *stride) {
+    if (pixFormat != pixDOUBLE) {
+        fprintf(stderr, "error: pixLockRGB: window is packed\n");
+        return NULL;
+    }
+    if (pixLocked)
+        fprintf(stderr, "warning: pixLockRGB: already locked\n");
+    pixRealizeRect(0, 0, pixWidth - 1, pixHeight - 1);
+    pixLocked = 1;
+    *stride = pixWidth * 3;
+    return pixColors;
+}
+
+void pixUnlockRGB(void) {
+    pixLocked = 0;
+    pixMarkDirty(0, 0, pixWidth - 1, pixHeight - 1);
+}
+
+void pixUnlockRGBRect(int x0, int y0, int x1, int y1) {
+    pixLocked = 0;
+    if (x0 < 0)
+        x0 = 0;
+    if (y0 < 0)
+        y0 = 0;
+    if (x1 >= pixWidth)
+        x1 = pixWidth - 1;
+    if (y1 >= pixHeight)
+        y1 = pixHeight - 1;
+    if (x0 <= x1 && y0 <= y1)
+        pixMarkDirty(x0, y0, x1, y1);
+}
+
+void pixSetRGBSpan(int x0, int x1, int y, const double rgb[]) {
+    if (y < 0 || y >= pixHeight)
+        return;
+    int first = (x0 < 0) ? 0 : x0;
+    int last = (x1 >= pixWidth) ? pixWidth - 1 : x1;
+    if (first > last)
+        return;
+    pixRealizeRect(first, y, last, y);
+    if (pixFormat == pixDOUBLE)
+        memcpy(&pixColors[(first + pixWidth * y) * 3], &rgb[(first - x0) * 3],
+            (last - first + 1) * 3 * sizeof(double));
+    else
+        pixPackSpan(last - first + 1, &rgb[(first - x0) * 3], 
+            &pixPacked[first + pixWidth * y]);
+    pixMarkDirty(first, y, last, y);
+}
+
+void pixFillRect(
+        int x0, int y0, int x1, int y1, double red, double green, 
+        double blue) {
+    if (x0 < 0)
+        x0 = 0;
+    if (y0 < 0)
+        y0 = 0;
+    if (x1 >= pixWidth)
+        x1 = pixWidth - 1;
+    if (y1 >= pixHeight)
+        y1 = pixHeight - 1;
+    if (x0 > x1 || y0 > y1)
+        return;
+    /* Tiles that the rectangle covers entirely need not be realized. */
+    int i, j, col, row, tile;
+    for (row = y0 / pixTILESIZE; row <= y1 / pixTILESIZE; row += 1)
+        for (col = x0 / pixTILESIZE; col <= x1 / pixTILESIZE; col += 1) {
+            tile = col + pixTileColNum * row;
+            if (x0 <= col * pixTILESIZE && y0 <= row * pixTILESIZE && 
+                    ((col + 1) * pixTILESIZE - 1 <= x1 || x1 == pixWidth - 1) 
+                    && ((row + 1) * pixTILESIZE - 1 <= y1 || 
+                    y1 == pixHeight - 1))
+                pixTileEpochs[pixBack][tile] = pixEpochs[pixBack];
+            else
+                pixRealizeTile(tile);
+        }
+    /* Fill the first row, and then copy it to the others. */
+    if (pixFormat == pixDOUBLE) {
+        double *row = &pixColors[(x0 + pixWidth * y0) * 3];
+        int rowSize = (x1 - x0 + 1) * 3;
+        for (i = 0; i < rowSize; i += 3) {
+            row[i] = red;
+            row[i + 1] = green;
+            row[i + 2] = blue;
+        }
+        for (j = y0 + 1; j <= y1; j += 1)
+            memcpy(&pixColors[(x0 + pixWidth * j) * 3], row,
+                rowSize * sizeof(double));
+    } else {
+        uint32_t *row = &pixPacked[x0 + pixWidth * y0], color;
+        double rgb[3] = {red, green, blue};
+        pixPackSpan(1, rgb, &color);
+        for (i = 0; i <= x1 - x0; i += 1)
+            row[i] = color;
+        for (j = y0 + 1; j <= y1; j += 1)
+            memcpy(&pixPacked[x0 + pixWidth * j], row,
+                (x1 - x0 + 1) * sizeof(uint32_t));
+    }
+    pixMarkDirty(x0, y0, x1, y1);
+}
+
+
+
+/*** Packed formats ***/
+
+int pixGetFormat(void) {
+    return pixFormat;
+}
+
+uint32_t *pixLockPacked(int *stride) {
+    if (pixFormat == pixDOUBLE) {
+        fprintf(stderr, "error: pixLockPacked: window is not packed\n");
+        return NULL;
+    }
+    if (pixLocked)
+        fprintf(stderr, "warning: pixLockPacked: already locked\n");
+    pixRealizeRect(0, 0, pixWidth - 1, pixHeight - 1);
+    pixLocked = 1;
+    *stride = pixWidth;
+    return pixPacked;
+}
+
+void pixCopyPacked(uint32_t *data) {
+    if (pixFormat == pixDOUBLE)
+        fprintf(stderr, "error: pixCopyPacked: window is not packed\n");
+    else {
+        pixRealizeRect(0, 0, pixWidth - 1, pixHeight - 1);
+        memcpy(data, pixPacked, pixWidth * pixHeight * sizeof(uint32_t));
+    }
+}
+
+void pixPastePacked(const uint32_t *data) {
+    if (pixFormat == pixDOUBLE)
+        fprintf(stderr, "error: pixPastePacked: window is not packed\n");
+    else {
+        int tile;
+        memcpy(pixPacked, data, pixWidth * pixHeight * sizeof(uint32_t));
+        for (tile = 0; tile < pixTileColNum * pixTileRowNum; tile += 1)
+            pixTileEpochs[pixBack][tile] = pixEpochs[pixBack];
+        pixMarkDirty(0, 0, pixWidth - 1, pixHeight - 1);
+    }
+}
+
+
+
+/*** Presentation ***/
+
+int pixSetPresentBuffers(int count) {
+    if (count < 0 || count > 3) {
+        fprintf(stderr, "error: pixSetPresentBuffers: bad count %d\n", count);
+        return 1;
+    }
+    int buffer;
+    pixStopPresenter();
+    /* Keep the current back buffer as buffer 0, so that nothing drawn so far 
+    is lost. */
+    pixSwapBuffers(0, pixBack);
+    for (buffer = 1; buffer < 3; buffer += 1) {
+        if (buffer < count && pixBuffers[buffer] == NULL) {
+            pixBuffers[buffer] = calloc(1, pixBufferSize());
+            pixDirty[buffer] = (unsigned char *)calloc(
+                pixTileColNum * pixTileRowNum, 1);
+            pixTileEpochs[buffer] = (unsigned int *)calloc(
+                pixTileColNum * pixTileRowNum, sizeof(unsigned int));
+            pixEpochs[buffer] = 0;
+        } else if (buffer >= count) {
+            free(pixBuffers[buffer]);
+            pixBuffers[buffer] = NULL;
+            free(pixDirty[buffer]);
+            pixDirty[buffer] = NULL;
+            free(pixTileEpochs[buffer]);
+            pixTileEpochs[buffer] = NULL;
+        }
+        pixBufferFences[buffer] = 0;
+    }
+    pixBufferFences[0] = 0;
+    if (count > 0 && pixFront == NULL)
+        pixFront = calloc(1, pixBufferSize());
+    else if (count == 0) {
+        free(pixFront);
+        pixFront = NULL;
+    }
+    for (buffer = 1; buffer < count; buffer += 1)
+        if (pixBuffers[buffer] == NULL || pixDirty[buffer] == NULL || 
+                pixTileEpochs[buffer] == NULL || pixFront == NULL) {
+            fprintf(stderr, "error: pixSetPresentBuffers: malloc failed\n");
+            pixSelectBuffer(0);
+            pixSetPresentBuffers(0);
+            return 2;
+        }
+    pixSelectBuffer(0);
+    /* The front buffer starts out unrelated to the window. */
+    pixMarkDirty(0, 0, pixWidth - 1, pixHeight - 1);
+    pixBufferNum = count;
+    pixInFlightLimit = (count > 1) ? count - 1 : 1;
+    pthread_mutex_lock(&pixMutex);
+    pixPresented = pixSubmitted;
+    pthread_mutex_unlock(&pixMutex);
+    if (count > 1) {
+        if (pthread_create(&pixPresenter, NULL, pixPresentLoop, NULL) != 0) {
+            fprintf(stderr, "error: pixSetPresentBuffers: no thread\n");
+            pixSetPresentBuffers(0);
+            return 3;
+        }
+        pixPresenterRunning = 1;
+    }
+    return 0;
+}
+
+void pixSetPresentHandler(void (*handler)(void)) {
+    pixPresentHandler = handler;
+}
+
+void pixSetFramesInFlight(int limit) {
+    if (pixBufferNum > 1 && limit > pixBufferNum - 1)
+        limit = pixBufferNum - 1;
+    pixInFlightLimit = (limit < 1) ? 1 : limit;
+}
+
+long pixGetFrameFence(void) {
+    pthread_mutex_lock(&pixMutex);
+    long fence = pixSubmitted;
+    pthread_mutex_unlock(&pixMutex);
+    return fence;
+}
+
+void pixWaitFence(long fence) {
+    pthread_mutex_lock(&pixMutex);
+    while (pixPresented < fence)
+        pthread_cond_wait(&pixCond, &pixMutex);
+    pthread_mutex_unlock(&pixMutex);
+}
+
+void pixCopyPresentedRGB(double *data) {
+    if (pixFront == NULL) {
+        pixCopyRGB(data);
+        return;
+    }
+    pthread_mutex_lock(&pixFrontMutex);
+    if (pixFormat == pixDOUBLE)
+        memcpy(data, pixFront, pixBufferSize());
+    else
+        pixUnpackSpan(pixWidth * pixHeight, (const uint32_t *)pixFront, data);
+    pthread_mutex_unlock(&pixFrontMutex);
+}
+
+
+
+/*** Dirty tracking ***/
+
+void pixGetTileGrid(int *colNum, int *rowNum) {
+    *colNum = pixTileColNum;
+    *rowNum = pixTileRowNum;
+}
+
+int pixGetDirtyTiles(unsigned char dirty[]) {
+    int tile, count = 0;
+    for (tile = 0; tile < pixTileColNum * pixTileRowNum; tile += 1) {
+        dirty[tile] = pixLastDirty[tile];
+        count += pixLastDirty[tile];
+    }
+    return count;
+}
+
+int pixGetDirtyRect(int *x0, int *y0, int *x1, int *y1) {
+    int col, row, colMin = pixTileColNum, colMax = -1;
+    int rowMin = pixTileRowNum, rowMax = -1;
+    for (row = 0; row < pixTileRowNum; row += 1)
+        for (col = 0; col < pixTileColNum; col += 1)
+            if (pixLastDirty[col + pixTileColNum * row]) {
+                colMin = (col < colMin) ? col : colMin;
+                colMax = (col > colMax) ? col : colMax;
+                rowMin = (row < rowMin) ? row : rowMin;
+                rowMax = (row > rowMax) ? row : rowMax;
+            }
+    if (colMax < 0)
+        return 0;
+    *x0 = colMin * pixTILESIZE;
+    *y0 = rowMin * pixTILESIZE;
+    *x1 = (colMax + 1) * pixTILESIZE - 1;
+    *y1 = (rowMax + 1) * pixTILESIZE - 1;
+    *x1 = (*x1 < pixWidth) ? *x1 : pixWidth - 1;
+    *y1 = (*y1 < pixHeight) ? *y1 : pixHeight - 1;
+    return 1;
+}
+
+
+
+/*** Capture ***/
+
+int pixStartCapture(
+        const char *path, int format, int slotNum, int workerNum, 
+        int policy) {
+    int slot, worker;
+    if (pixCapturing) {
+        fprintf(stderr, "error: pixStartCapture: already capturing\n");
+        return 1;
+    }
+    if (slotNum < 1 || slotNum > pixCAPTUREMAX || workerNum < 1 || 
+            workerNum > pixCAPTUREMAX || strlen(path) >= sizeof(pixCapturePath)) {
+        fprintf(stderr, "error: pixStartCapture: bad arguments\n");
+        return 2;
+    }
+    if (format == pixCAPTURERAW) {
+        pixRawFile = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (pixRawFile < 0) {
+            fprintf(stderr, "error: pixStartCapture: cannot open %s\n", path);
+            return 3;
+        }
+    }
+    strcpy(pixCapturePath, path);
+    pixCaptureFormat = format;
+    pixCapturePolicy = policy;
+    pixCaptureFrame = 0;
+    pixSnapshotNum = 0;
+    pixDropNum = 0;
+    pixWriteNum = 0;
+    pixCaptureWait = 0.0;
+    pixWorkersQuitting = 0;
+    for (slot = 0; slot < slotNum; slot += 1) {
+        pixSlots[slot] = malloc(pixBufferSize());
+        pixSlotStates[slot] = pixSLOTFREE;
+        if (pixSlots[slot] == NULL) {
+            fprintf(stderr, "error: pixStartCapture: malloc failed\n");
+            pixSlotNum = slot;
+            pixWorkerNum = 0;
+            pixCapturing = 1;
+            pixStopCapture();
+            return 4;
+        }
+    }
+    pixSlotNum = slotNum;
+    for (worker = 0; worker < workerNum; worker += 1)
+        if (pthread_create(&pixWorkers[worker], NULL, pixCaptureLoop, NULL) != 
+                0) {
+            fprintf(stderr, "error: pixStartCapture: no thread\n");
+            pixWorkerNum = worker;
+            pixCapturing = 1;
+            pixStopCapture();
+            return 5;
+        }
+    pixWorkerNum = workerNum;
+    pixCapturing = 1;
+    return 0;
+}
+
+void pixStopCapture(void) {
+    int slot, worker;
+    if (!pixCapturing)
+        return;
+    pthread_mutex_lock(&pixCaptureMutex);
+    pixWorkersQuitting = 1;
+    pthread_cond_broadcast(&pixCaptureCond);
+    pthread_mutex_unlock(&pixCaptureMutex);
+    for (worker = 0; worker < pixWorkerNum; worker += 1)
+        pthread_join(pixWorkers[worker], NULL);
+    for (slot = 0; slot < pixSlotNum; slot += 1) {
+        free(pixSlots[slot]);
+        pixSlots[slot] = NULL;
+    }
+    if (pixRawFile >= 0)
+        close(pixRawFile);
+    pixRawFile = -1;
+    pixSlotNum = 0;
+    pixWorkerNum = 0;
+    pixCapturing = 0;
+}
+
+void pixGetCaptureStats(
+        long *snapshotNum, long *dropNum, long *writeNum, double *waitTime) {
+    pthread_mutex_lock(&pixCaptureMutex);
+    *snapshotNum = pixSnapshotNum;
+    *dropNum = pixDropNum;
+    *writeNum = pixWriteNum;
+    *waitTime = pixCaptureWait;
+    pthread_mutex_unlock(&pixCaptureMutex);
+}
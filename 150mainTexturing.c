@@ -13,6 +13,7 @@ On Ubuntu, compile with...
 
 #include "080vector.c"
 #include "100matrix.c"
+#include "390trace.c"
 #include "150texture.c"
 #include "140triangle.c"
 
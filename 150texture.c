@@ -77,18 +77,21 @@ int texInitializeFile(texTexture *tex, const char *path) {
     /* Use the STB image library to load the file as unsigned chars. */
     unsigned char *rawData;
     int x, y, z, newInd, oldInd;
+    traceBegin("texInitializeFile");
     rawData = stbi_load(path, &(tex->width), &(tex->height), &(tex->texelDim), 
         0);
     if (rawData == NULL) {
         fprintf(stderr, "error: texInitializeFile: failed to load image %s\n", 
             path);
         fprintf(stderr, "    with STB Image reason: %s\n", stbi_failure_reason());
+        traceEnd();
         return 2;
     }
     tex->data = (double *)malloc((tex->width * tex->height) * tex->texelDim * sizeof(double));
     if (tex->data == NULL) {
         fprintf(stderr, "error: texInitializeFile: malloc failed\n");
         stbi_image_free(rawData);
+        traceEnd();
         return 1;
     }
     /* STB Image starts in the upper-left, while I want the lower-left. */
@@ -100,6 +103,7 @@ int texInitializeFile(texTexture *tex, const char *path) {
                 tex->data[newInd + z] = rawData[oldInd + z] / 255.0;
         }
     stbi_image_free(rawData);
+    traceEnd();
     return 0;
 }
 
@@ -16,6 +16,7 @@ On Ubuntu, compile with...
 
 #include "080vector.c"
 #include "100matrix.c"
+#include "390trace.c"
 #include "150texture.c"
 #include "200shading.c"
 
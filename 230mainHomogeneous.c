@@ -17,6 +17,7 @@
 
 #include "080vector.c"
 #include "230matrix.c"
+#include "390trace.c"
 #include "150texture.c"
 #include "220shading.c"
 #include "220triangle.c"
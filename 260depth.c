@@ -1,31 +1,175 @@
+#include <stdint.h>
 
+/*** Creating and destroying (once per program?) ***/
 
+/* Clearing is lazy. The buffer is divided into depthTILESIZE x depthTILESIZE 
+tiles, and depthClearDepths merely increments the buffer's epoch. A tile whose 
+epoch is behind the buffer's epoch holds stale values, and every depth in it 
+reads as the clear depth. The tile is actually filled with the clear depth the 
+first time that one of its depths is set. So a frame pays only for the tiles 
+that it touches.
 
-/*** Creating and destroying (once per program?) ***/
+Each pixel also has a mark, a flag that a rendering pass can set once it has 
+dealt with the pixel. The marks are cleared along with the depths.
+
+A multisample buffer, made by depthInitializeMultisample, holds sampleNum 
+depths per pixel, for the coverage samples of an antialiasing rasterizer. The 
+depths of a pixel are consecutive. The functions that take no sample index, 
+such as depthGetDepth, work on sample 0, and depthGetBlock works only with one 
+sample per pixel.
+
+The depths are stored in one of several formats, chosen by depthInitializeFormat. 
+depthDOUBLE, the default, stores doubles. depthFLOAT stores floats, in half the 
+memory. depthUNORM24 and depthUNORM32 store a depth d in [0, 1] as the unsigned 
+integer nearest d * (2^24 - 1) or d * (2^32 - 1), in 32 bits, and clamp other 
+depths to that range, as graphics hardware does. The viewport transformation 
+puts the visible depths in [0, 1]. The accessors take and return doubles in 
+every format, but the tests (depthTestLess, etc.) compare depths as stored, so 
+that a depth that has been written always compares equal to itself.
+
+The layout of the depths in memory is chosen by depthInitializeLayout. In 
+depthLINEAR, the default, pixel (i, j) comes at index i + width * j, row by 
+row. In depthTILED, each depthTILESIZE x depthTILESIZE tile is stored 
+contiguously, row by row within the tile, and the tiles follow one another row 
+by row. A tile then spans a few consecutive cache lines, whichever way a 
+rasterizer walks it, while a row of a tile is still contiguous, as 
+depthGetBlock requires. Use depthIndex to find a pixel, or depthReadDepths to 
+copy the depths out in row-major order.
+
+For hierarchical depth testing, each tile also keeps bounds on its stored 
+depths: the nearest depth, lowered as depths are written, and the farthest, 
+recomputed only when it is asked for after a write. A rasterizer can then 
+compare a triangle's range of depths over a tile with these bounds, and skip 
+the tile if the triangle is behind all of it, or skip the per-pixel comparisons 
+if the triangle is in front of all of it (see depthGetTileMin). */
+#define depthTILESIZE 8
+
+#define depthDOUBLE 0
+#define depthFLOAT 1
+#define depthUNORM24 2
+#define depthUNORM32 3
+
+#define depthLINEAR 0
+#define depthTILED 1
 
 /* Feel free to read the struct's members, but don't write them, except through 
 the accessors below such as depthSetDepth, etc. */
 typedef struct depthBuffer depthBuffer;
 struct depthBuffer {
 	int width, height;
-	double *depths;			/* width * height doubles */
+	int sampleNum;
+	int format, layout;
+	void *depths;			/* sampleNum depths per pixel, as format and layout */
+	unsigned char *marks;	/* width * height flags */
+	int tileColNum, tileRowNum;
+	unsigned int *tileEpochs;	/* tileColNum * tileRowNum epochs */
+	double *tileMins, *tileMaxs;	/* tileColNum * tileRowNum bounds */
+	unsigned char *tileMaxStale;	/* tileColNum * tileRowNum flags */
+	unsigned int epoch;
+	double clearDepth;
 };
 
-/* Initializes a depth buffer. When you are finished with the buffer, you must 
-call depthFinalize to deallocate its backing resources. */
-int depthInitialize(depthBuffer *buf, int width, int height) {
-	buf->depths = (double *)malloc(width * height * sizeof(double));
-	if (buf->depths != NULL) {
-		buf->width = width;
-		buf->height = height;
+/* Returns the number of bytes that one depth occupies in the given format. */
+int depthFormatSize(int format) {
+	return (format == depthDOUBLE) ? sizeof(double) : 
+		((format == depthFLOAT) ? sizeof(float) : sizeof(uint32_t));
+}
+
+/* Returns the largest integer of a depthUNORM24 or depthUNORM32 format, which 
+stands for depth 1. */
+double depthUnormMax(int format) {
+	return (format == depthUNORM24) ? 16777215.0 : 4294967295.0;
+}
+
+/* Returns the integer that stands for the given depth, in a normalized format 
+whose largest integer is max. */
+uint32_t depthEncodeUnorm(double depth, double max) {
+	if (!(depth > 0.0))
+		return 0;
+	if (depth >= 1.0)
+		return (uint32_t)max;
+	return (uint32_t)(depth * max + 0.5);
+}
+
+/* Initializes a depth buffer with sampleNum depths per pixel, stored in the 
+given format and layout. When you are finished with the buffer, you must call 
+depthFinalize to deallocate its backing resources. */
+int depthInitializeLayout(
+		depthBuffer *buf, int width, int height, int sampleNum, int format, 
+		int layout) {
+	buf->tileColNum = (width + depthTILESIZE - 1) / depthTILESIZE;
+	buf->tileRowNum = (height + depthTILESIZE - 1) / depthTILESIZE;
+	/* The tiled layout pads the buffer to whole tiles. */
+	if (layout == depthTILED)
+		buf->depths = malloc((size_t)buf->tileColNum * buf->tileRowNum * 
+			depthTILESIZE * depthTILESIZE * sampleNum * depthFormatSize(format));
+	else
+		buf->depths = malloc(
+			(size_t)width * height * sampleNum * depthFormatSize(format));
+	buf->marks = (unsigned char *)malloc((size_t)width * height);
+	buf->tileEpochs = (unsigned int *)calloc(
+		(size_t)buf->tileColNum * buf->tileRowNum, sizeof(unsigned int));
+	buf->tileMins = (double *)malloc(
+		(size_t)buf->tileColNum * buf->tileRowNum * sizeof(double));
+	buf->tileMaxs = (double *)malloc(
+		(size_t)buf->tileColNum * buf->tileRowNum * sizeof(double));
+	buf->tileMaxStale = (unsigned char *)calloc(
+		(size_t)buf->tileColNum * buf->tileRowNum, 1);
+	if (buf->depths == NULL || buf->marks == NULL || buf->tileEpochs == NULL || 
+			buf->tileMins == NULL || buf->tileMaxs == NULL || 
+			buf->tileMaxStale == NULL) {
+		free(buf->depths);
+		free(buf->marks);
+		free(buf->tileEpochs);
+		free(buf->tileMins);
+		free(buf->tileMaxs);
+		free(buf->tileMaxStale);
+		buf->depths = NULL;
+		return 1;
 	}
-	return (buf->depths == NULL);
+	buf->width = width;
+	buf->height = height;
+	buf->sampleNum = sampleNum;
+	buf->format = format;
+	buf->layout = layout;
+	buf->epoch = 0;
+	buf->clearDepth = 0.0;
+	return 0;
+}
+
+/* Initializes a depth buffer with sampleNum depths per pixel, stored in the 
+given format, in depthLINEAR layout. When you are finished with the buffer, you 
+must call depthFinalize to deallocate its backing resources. */
+int depthInitializeFormat(
+		depthBuffer *buf, int width, int height, int sampleNum, int format) {
+	return depthInitializeLayout(
+		buf, width, height, sampleNum, format, depthLINEAR);
+}
+
+/* Initializes a depth buffer of doubles with sampleNum depths per pixel. When 
+you are finished with the buffer, you must call depthFinalize to deallocate its 
+backing resources. */
+int depthInitializeMultisample(
+		depthBuffer *buf, int width, int height, int sampleNum) {
+	return depthInitializeFormat(buf, width, height, sampleNum, depthDOUBLE);
+}
+
+/* Initializes a depth buffer of doubles with one depth per pixel. When you are 
+finished with the buffer, you must call depthFinalize to deallocate its backing 
+resources. */
+int depthInitialize(depthBuffer *buf, int width, int height) {
+	return depthInitializeMultisample(buf, width, height, 1);
 }
 
 /* Deallocates the resources backing the buffer. This function must be called 
 when you are finished using a buffer. */
 void depthFinalize(depthBuffer *buf) {
 	free(buf->depths);
+	free(buf->marks);
+	free(buf->tileEpochs);
+	free(buf->tileMins);
+	free(buf->tileMaxs);
+	free(buf->tileMaxStale);
 }
 
 
@@ -33,27 +177,340 @@ void depthFinalize(depthBuffer *buf) {
 /*** Regular use (on each frame) ***/
 
 /* Sets every depth-value to the given depth. Typically you use this function 
-at the start of each frame, passing a large positive value for depth. */
+at the start of each frame, passing a large positive value for depth. The cost 
+does not depend on the size of the buffer. */
 void depthClearDepths(depthBuffer *buf, double depth) {
+	traceBegin("depthClearDepths");
+	buf->clearDepth = depth;
+	buf->epoch += 1;
+	if (buf->epoch == 0) {
+		/* The epoch has wrapped around. Make every tile stale again. */
+		int tile;
+		for (tile = 0; tile < buf->tileColNum * buf->tileRowNum; tile += 1)
+			buf->tileEpochs[tile] = 0;
+		buf->epoch = 1;
+	}
+	traceEnd();
+}
+
+/* Stores the given depth in the n consecutive depths starting at index k of 
+the buffer's array. */
+void depthFill(depthBuffer *buf, int k, int n, double depth) {
+	int m;
+	if (buf->format == depthDOUBLE) {
+		double *depths = (double *)buf->depths + k;
+		for (m = 0; m < n; m += 1)
+			depths[m] = depth;
+	} else if (buf->format == depthFLOAT) {
+		float *depths = (float *)buf->depths + k;
+		for (m = 0; m < n; m += 1)
+			depths[m] = (float)depth;
+	} else {
+		uint32_t *depths = (uint32_t *)buf->depths + k;
+		uint32_t unorm = depthEncodeUnorm(depth, depthUnormMax(buf->format));
+		for (m = 0; m < n; m += 1)
+			depths[m] = unorm;
+	}
+}
+
+/* Returns the depth stored at index k of the buffer's array. */
+double depthLoad(const depthBuffer *buf, int k) {
+	if (buf->format == depthDOUBLE)
+		return ((const double *)buf->depths)[k];
+	else if (buf->format == depthFLOAT)
+		return ((const float *)buf->depths)[k];
+	else
+		return ((const uint32_t *)buf->depths)[k] / depthUnormMax(buf->format);
+}
+
+/* Returns the given depth as the buffer's format stores it. Rounding in this 
+way preserves order, so a depth less than another, once both are rounded, was 
+less before. */
+double depthQuantize(const depthBuffer *buf, double depth) {
+	if (buf->format == depthDOUBLE)
+		return depth;
+	else if (buf->format == depthFLOAT)
+		return (float)depth;
+	else
+		return depthEncodeUnorm(depth, depthUnormMax(buf->format)) / 
+			depthUnormMax(buf->format);
+}
+
+/* Returns the clear depth, as the buffer's format stores it. */
+double depthStoredClearDepth(const depthBuffer *buf) {
+	return depthQuantize(buf, buf->clearDepth);
+}
+
+/* Updates the bounds of the given tile, which must not be stale, after the 
+given depth has been written into it. */
+void depthNoteWrite(depthBuffer *buf, int tile, double depth) {
+	depth = depthQuantize(buf, depth);
+	if (depth < buf->tileMins[tile])
+		buf->tileMins[tile] = depth;
+	buf->tileMaxStale[tile] = 1;
+}
+
+/* Returns the index of the tile containing pixel (i, j). */
+int depthTile(const depthBuffer *buf, int i, int j) {
+	return i / depthTILESIZE + buf->tileColNum * (j / depthTILESIZE);
+}
+
+/* Returns the index, in the buffer's array, of the first depth of pixel 
+(i, j), which must lie within the buffer. Its other samples follow it. */
+int depthIndex(const depthBuffer *buf, int i, int j) {
+	if (buf->layout == depthTILED)
+		return ((depthTile(buf, i, j) * depthTILESIZE + j % depthTILESIZE) * 
+			depthTILESIZE + i % depthTILESIZE) * buf->sampleNum;
+	return (i + buf->width * j) * buf->sampleNum;
+}
+
+/* If the given tile is stale, then fills it with the clear depth and clears its 
+marks, so that its depths and marks can be written. */
+void depthRealizeTile(depthBuffer *buf, int tile) {
+	if (buf->tileEpochs[tile] == buf->epoch)
+		return;
+	int i0 = (tile % buf->tileColNum) * depthTILESIZE;
+	int j0 = (tile / buf->tileColNum) * depthTILESIZE;
+	int i1 = (i0 + depthTILESIZE < buf->width) ? i0 + depthTILESIZE : buf->width;
+	int j1 = (j0 + depthTILESIZE < buf->height) ? j0 + depthTILESIZE : 
+		buf->height;
 	int i, j;
-	for (i = 0; i < buf->width; i += 1)
-		for (j = 0; j < buf->height; j += 1)
-			buf->depths[i + buf->width * j] = depth;
+	for (j = j0; j < j1; j += 1) {
+		depthFill(buf, depthIndex(buf, i0, j), (i1 - i0) * buf->sampleNum, 
+			buf->clearDepth);
+		for (i = i0; i < i1; i += 1)
+			buf->marks[i + buf->width * j] = 0;
+	}
+	buf->tileMins[tile] = depthStoredClearDepth(buf);
+	buf->tileMaxs[tile] = buf->tileMins[tile];
+	buf->tileMaxStale[tile] = 0;
+	buf->tileEpochs[tile] = buf->epoch;
 }
 
 /* Sets the depth-value at pixel (i, j) to the given depth. */
 void depthSetDepth(depthBuffer *buf, int i, int j, double depth) {
-	if (0 <= i && i < buf->width && 0 <= j && j < buf->height)
-		buf->depths[i + buf->width * j] = depth;
+	if (0 <= i && i < buf->width && 0 <= j && j < buf->height) {
+		depthRealizeTile(buf, depthTile(buf, i, j));
+		depthFill(buf, depthIndex(buf, i, j), 1, depth);
+		depthNoteWrite(buf, depthTile(buf, i, j), depth);
+	}
+}
+
+/* Returns a pointer to the depth-value at pixel (i, j), which must lie within 
+the buffer, so that a rasterizer can read and write a row of depths at once. 
+The pointer is good for the pixels (i, j) through the end of the tile's row, 
+that is, up to the next pixel whose i is a multiple of depthTILESIZE. It points 
+to a double, a float, or a uint32_t, according to the buffer's format. */
+void *depthGetBlock(depthBuffer *buf, int i, int j) {
+	depthRealizeTile(buf, depthTile(buf, i, j));
+	return (char *)buf->depths + 
+		depthIndex(buf, i, j) * depthFormatSize(buf->format);
 }
 
 /* Returns the depth-value at pixel (i, j). */
 double depthGetDepth(const depthBuffer *buf, int i, int j) {
-	if (0 <= i && i < buf->width && 0 <= j && j < buf->height)
-		return buf->depths[i + buf->width * j];
-	else
+	if (0 <= i && i < buf->width && 0 <= j && j < buf->height) {
+		if (buf->tileEpochs[depthTile(buf, i, j)] != buf->epoch)
+			return depthStoredClearDepth(buf);
+		return depthLoad(buf, depthIndex(buf, i, j));
+	} else
 		/* There's no right answer, but we have to return something. */
 		return 0.0;
 }
 
+/* Sets the mark at pixel (i, j). */
+void depthSetMark(depthBuffer *buf, int i, int j) {
+	if (0 <= i && i < buf->width && 0 <= j && j < buf->height) {
+		depthRealizeTile(buf, depthTile(buf, i, j));
+		buf->marks[i + buf->width * j] = 1;
+	}
+}
+
+/* Returns whether the mark at pixel (i, j) is set. */
+int depthGetMark(const depthBuffer *buf, int i, int j) {
+	if (0 <= i && i < buf->width && 0 <= j && j < buf->height) {
+		if (buf->tileEpochs[depthTile(buf, i, j)] != buf->epoch)
+			return 0;
+		return buf->marks[i + buf->width * j];
+	} else
+		return 0;
+}
+
+/* Sets the depth-value at every pixel (i, j) with i0 <= i <= i1 and 
+j0 <= j <= j1 to the given depth, and clears the marks there. The rectangle is 
+clipped to the buffer. Unlike depthClearDepths, this function is not lazy, but 
+its cost depends only on the tiles that the rectangle touches. */
+void depthClearDepthsRect(
+		depthBuffer *buf, double depth, int i0, int j0, int i1, int j1) {
+	int i, j, n, col, row;
+	i0 = (i0 < 0) ? 0 : i0;
+	j0 = (j0 < 0) ? 0 : j0;
+	i1 = (i1 > buf->width - 1) ? buf->width - 1 : i1;
+	j1 = (j1 > buf->height - 1) ? buf->height - 1 : j1;
+	if (i0 > i1 || j0 > j1)
+		return;
+	traceBegin("depthClearDepthsRect");
+	for (row = j0 / depthTILESIZE; row <= j1 / depthTILESIZE; row += 1)
+		for (col = i0 / depthTILESIZE; col <= i1 / depthTILESIZE; col += 1) {
+			depthRealizeTile(buf, col + buf->tileColNum * row);
+			depthNoteWrite(buf, col + buf->tileColNum * row, depth);
+		}
+	for (j = j0; j <= j1; j += 1) {
+		/* The depths are contiguous within each row of each tile. */
+		for (i = i0; i <= i1; i += n) {
+			n = depthTILESIZE - i % depthTILESIZE;
+			n = (i + n - 1 > i1) ? i1 - i + 1 : n;
+			depthFill(buf, depthIndex(buf, i, j), n * buf->sampleNum, depth);
+		}
+		for (i = i0; i <= i1; i += 1)
+			buf->marks[i + buf->width * j] = 0;
+	}
+	traceEnd();
+}
+
+/* Returns depth-value number s of pixel (i, j). */
+double depthGetSample(const depthBuffer *buf, int i, int j, int s) {
+	if (0 <= i && i < buf->width && 0 <= j && j < buf->height && 0 <= s && 
+			s < buf->sampleNum) {
+		if (buf->tileEpochs[depthTile(buf, i, j)] != buf->epoch)
+			return depthStoredClearDepth(buf);
+		return depthLoad(buf, depthIndex(buf, i, j) + s);
+	} else
+		return 0.0;
+}
+
+/* Compares the given depths with the stored depths of the samples of pixel 
+(i, j) whose bits are set in mask. Bit s stands for sample s. Where a depth is 
+less, in the buffer's format, stores it. Returns the mask of the samples that 
+passed. */
+int depthTestSamples(
+		depthBuffer *buf, int i, int j, int mask, const double depths[]) {
+	int k, s, pass = 0;
+	if (i < 0 || i >= buf->width || j < 0 || j >= buf->height)
+		return 0;
+	depthRealizeTile(buf, depthTile(buf, i, j));
+	k = depthIndex(buf, i, j);
+	if (buf->format == depthDOUBLE) {
+		double *stored = (double *)buf->depths + k;
+		for (s = 0; s < buf->sampleNum; s += 1)
+			if ((mask & (1 << s)) && depths[s] < stored[s]) {
+				stored[s] = depths[s];
+				pass |= 1 << s;
+			}
+	} else if (buf->format == depthFLOAT) {
+		float *stored = (float *)buf->depths + k;
+		for (s = 0; s < buf->sampleNum; s += 1)
+			if ((mask & (1 << s)) && (float)depths[s] < stored[s]) {
+				stored[s] = (float)depths[s];
+				pass |= 1 << s;
+			}
+	} else {
+		uint32_t *stored = (uint32_t *)buf->depths + k, unorm;
+		double max = depthUnormMax(buf->format);
+		for (s = 0; s < buf->sampleNum; s += 1) {
+			unorm = depthEncodeUnorm(depths[s], max);
+			if ((mask & (1 << s)) && unorm < stored[s]) {
+				stored[s] = unorm;
+				pass |= 1 << s;
+			}
+		}
+	}
+	for (s = 0; s < buf->sampleNum; s += 1)
+		if (pass & (1 << s))
+			depthNoteWrite(buf, depthTile(buf, i, j), depths[s]);
+	return pass;
+}
+
+/* Compares the given depth with the stored depth at pixel (i, j). If the depth 
+is less, in the buffer's format, then stores it and returns 1. Otherwise 
+returns 0. */
+int depthTestLess(depthBuffer *buf, int i, int j, double depth) {
+	return depthTestSamples(buf, i, j, 1, &depth);
+}
+
+/* Returns whether the given depth equals the stored depth at pixel (i, j), in 
+the buffer's format. */
+int depthTestEqual(const depthBuffer *buf, int i, int j, double depth) {
+	if (buf->format == depthUNORM24 || buf->format == depthUNORM32)
+		return depthEncodeUnorm(depth, depthUnormMax(buf->format)) == 
+			depthEncodeUnorm(depthGetDepth(buf, i, j), 
+			depthUnormMax(buf->format));
+	else if (buf->format == depthFLOAT)
+		return (float)depth == (float)depthGetDepth(buf, i, j);
+	else
+		return depth == depthGetDepth(buf, i, j);
+}
+
+/* Updates the bounds of the tile containing pixel (x0, y) after a rasterizer 
+has written depths[k] at pixel (x0 + k, y), through depthGetBlock, for each k 
+whose bit is set in mask. The pixels must lie in one tile. */
+void depthNoteBlock(
+		depthBuffer *buf, int x0, int y, int mask, const double depths[]) {
+	int tile = depthTile(buf, x0, y), k;
+	double nearest = INFINITY;
+	for (k = 0; mask != 0; k += 1, mask >>= 1)
+		if ((mask & 1) && depths[k] < nearest)
+			nearest = depths[k];
+	if (nearest < INFINITY)
+		depthNoteWrite(buf, tile, nearest);
+}
 
+/* Sets depths[k] at pixel (x0 + k, y) for each k whose bit is set in mask, 
+without comparing, and updates the tile's bounds. The pixels must lie in one 
+tile of the buffer. */
+void depthSetBlock(
+		depthBuffer *buf, int x0, int y, int mask, const double depths[]) {
+	int k;
+	depthRealizeTile(buf, depthTile(buf, x0, y));
+	for (k = 0; k < depthTILESIZE; k += 1)
+		if (mask & (1 << k))
+			depthFill(buf, depthIndex(buf, x0 + k, y), 1, depths[k]);
+	depthNoteBlock(buf, x0, y, mask, depths);
+}
+
+/* Returns a depth no greater than any depth stored in the given tile, in the 
+buffer's format. A fragment whose depth, rounded by depthQuantize, is less than 
+this passes the depth test wherever it lands in the tile. */
+double depthGetTileMin(const depthBuffer *buf, int tile) {
+	if (buf->tileEpochs[tile] != buf->epoch)
+		return depthStoredClearDepth(buf);
+	return buf->tileMins[tile];
+}
+
+/* Returns the greatest depth stored in the given tile, in the buffer's format. 
+A fragment whose depth, rounded by depthQuantize, is greater than this fails 
+the depth test, or the test for equality, wherever it lands in the tile. */
+double depthGetTileMax(depthBuffer *buf, int tile) {
+	int i0, j0, i1, j1, i, j, s;
+	double depth, farthest;
+	if (buf->tileEpochs[tile] != buf->epoch)
+		return depthStoredClearDepth(buf);
+	if (buf->tileMaxStale[tile]) {
+		i0 = (tile % buf->tileColNum) * depthTILESIZE;
+		j0 = (tile / buf->tileColNum) * depthTILESIZE;
+		i1 = (i0 + depthTILESIZE < buf->width) ? i0 + depthTILESIZE : buf->width;
+		j1 = (j0 + depthTILESIZE < buf->height) ? j0 + depthTILESIZE : 
+			buf->height;
+		farthest = -INFINITY;
+		for (j = j0; j < j1; j += 1)
+			for (i = i0; i < i1; i += 1)
+				for (s = 0; s < buf->sampleNum; s += 1) {
+					depth = depthLoad(buf, depthIndex(buf, i, j) + s);
+					if (depth > farthest)
+						farthest = depth;
+				}
+		buf->tileMaxs[tile] = farthest;
+		buf->tileMaxStale[tile] = 0;
+	}
+	return buf->tileMaxs[tile];
+}
+
+/* Copies depth-value 0 of every pixel into depths, which has room for 
+width * height doubles, with pixel (i, j) at index i + width * j, whatever the 
+buffer's layout and format. */
+void depthReadDepths(const depthBuffer *buf, double depths[]) {
+	int i, j;
+	for (j = 0; j < buf->height; j += 1)
+		for (i = 0; i < buf->width; i += 1)
+			depths[i + buf->width * j] = depthGetDepth(buf, i, j);
+}
@@ -17,6 +17,7 @@ On Ubuntu, compile with...
 
 #include "250vector.c"
 #include "250matrix.c"
+#include "390trace.c"
 #include "150texture.c"
 #include "260depth.c"
 #include "260shading.c"
@@ -1,6 +1,27 @@
 /** Defines the shaShading data type which stores
  * the metadata of the arrays and functions passed 
  * to the shader program
+ *
+ * A shader program may also provide shadeFragments,
+ * which shades count fragments of one triangle in one
+ * call. Its varyings are laid out by varying rather
+ * than by fragment: varying m of fragment k is
+ * varys[m * count + k]. Its output is laid out the same
+ * way: channel n of fragment k is rgbds[n * count + k],
+ * where the channels are red, green, blue, and depth.
+ * Then the shader can work on all of the fragments at
+ * once, and do the work common to them only once. If
+ * shadeFragments is NULL, then shaShadeFragments falls
+ * back to calling shadeFragment once per fragment.
+ *
+ * If the fragment shader's depth is just one of its
+ * varyings, passed through unmodified, then depthVary
+ * may be set to that varying's index. Then the
+ * rasterizer tests the depth before shading (early-Z),
+ * and shades only the fragments that pass. Varying 0 is
+ * always the x-coordinate, so depthVary is 0 for shaders
+ * that compute their own depth, which are tested after
+ * shading (late-Z).
  */
 typedef struct shaShading shaShading;
 struct shaShading{
@@ -10,4 +31,35 @@ struct shaShading{
     int varyDim;
     void (*shadeVertex)(int, const double *, int, const double *, int, double *);
     void (*shadeFragment)(int, const double *, int, const texTexture **, int, const double *, double *);
+    void (*shadeFragments)(int, const double *, int, const texTexture **, int, int, const double *, double *);
+    int depthVary;
 };
+
+/** Shades count fragments, with the varyings and the
+ * output laid out as for shadeFragments, using
+ * shadeFragments if the shader program has it, and
+ * otherwise shadeFragment once per fragment. With one
+ * fragment the two layouts agree, so a rasterizer can
+ * pass the varyings and rgbd of a single pixel as they
+ * are.
+ */
+void shaShadeFragments(const shaShading *sha, const double unif[], const texTexture *tex[], 
+        int count, const double varys[], double rgbds[]){
+    if(sha->shadeFragments != NULL){
+        sha->shadeFragments(sha->unifDim, unif, sha->texNum, tex, sha->varyDim, count, varys, rgbds);
+    }
+    else if(count == 1){
+        sha->shadeFragment(sha->unifDim, unif, sha->texNum, tex, sha->varyDim, varys, rgbds);
+    }
+    else{
+        double vary[sha->varyDim], rgbd[4];
+        int k, m;
+        for(k = 0; k < count; k++){
+            for(m = 0; m < sha->varyDim; m++)
+                vary[m] = varys[m * count + k];
+            sha->shadeFragment(sha->unifDim, unif, sha->texNum, tex, sha->varyDim, vary, rgbd);
+            for(m = 0; m < 4; m++)
+                rgbds[m * count + k] = rgbd[m];
+        }
+    }
+}
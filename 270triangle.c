@@ -3,6 +3,181 @@
 #include <math.h>
 #include <GLFW/glfw3.h>
 #include "040pixel.h"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define triAVX2 1
+#endif
+
+
+/** The rendering passes. In triPASSSINGLE, the default, each
+ * fragment is depth-tested and shaded in one go. A depth pre-pass
+ * renders the frame twice instead. In triPASSDEPTH, only depths are
+ * written, and shaders that pass their depth through (see depthVary
+ * in 260shading.c) are not run at all. In triPASSCOLOR, a fragment
+ * is kept only if its depth equals the stored depth and the pixel
+ * is not yet marked, and then the pixel is marked. Both passes
+ * compute the same depths, so each visible pixel is shaded once, by
+ * the same triangle that would win in a single pass. In
+ * triPASSVISIBILITY, shaders that pass their depth through are not
+ * run either. Instead, each fragment that passes the depth test
+ * records its triangle's ID, as set by triSetID, and its
+ * barycentric coordinates in the visibility buffer set by
+ * triSetVisibility, to be shaded later (see 420deferred.c). Other
+ * shaders, and triangles whose ID is -1, are run as usual, and their
+ * fragments clear the ID.
+*/
+#define triPASSSINGLE 0
+#define triPASSDEPTH 1
+#define triPASSCOLOR 2
+#define triPASSVISIBILITY 3
+
+int triPass = triPASSSINGLE;
+visBuffer *triVis = NULL;
+__thread int triID = -1;
+/* How many places triRenderClipped has rotated the vertices before
+ * handing them to triRenderHelper, so that renderPixel can record
+ * barycentric coordinates with respect to the caller's vertices. */
+__thread int triRotation = 0;
+
+/** Selects the pass that triRender renders. */
+void triSetPass(int pass){
+    triPass = pass;
+}
+
+/** The multisample buffer that triRender draws into, or NULL. */
+msBuffer *triMS = NULL;
+
+/** Makes triRender antialias, by drawing into the given multisample
+ * buffer rather than the window, with a depth buffer made by
+ * depthInitializeMultisample or depthInitializeFormat with
+ * msSAMPLENUM samples, in any format. Pass NULL to
+ * draw into the window again. Only triPASSSINGLE is supported while
+ * multisampling.
+*/
+void triSetMultisample(msBuffer *ms){
+    triMS = ms;
+}
+
+/** The heat buffer that counts the fragments of triRender, or NULL. */
+heatBuffer *triHeat = NULL;
+
+/** Makes triRender count, at each pixel of the given heat buffer,
+ * the fragments that it shades, rejects by depth, and writes. Pass
+ * NULL to stop counting.
+*/
+void triSetHeatMap(heatBuffer *heat){
+    triHeat = heat;
+}
+
+/** Adds 1 to the heat count of the given kind at each pixel
+ * (x0 + k, y) whose bit k is set in mask.
+*/
+void triHeatCount(int kind, int x0, int y, int mask){
+    int k;
+    if(triHeat == NULL)
+        return;
+    for(k = 0; mask != 0; k++, mask >>= 1)
+        if(mask & 1)
+            heatCount(triHeat, kind, x0 + k, y, 1);
+}
+
+/** Sets the visibility buffer that triPASSVISIBILITY writes. */
+void triSetVisibility(visBuffer *vis){
+    triVis = vis;
+}
+
+/** Sets the ID that the calling thread records for the triangles
+ * that it renders in triPASSVISIBILITY.
+*/
+void triSetID(int id){
+    triID = id;
+}
+
+/** The scissor rectangle {xMin, yMin, xMax, yMax}, in whole pixels
+ * with the bounds included. When triScissoring is nonzero, triRender
+ * and triClear touch only the pixels inside it, and the rasterizers
+ * do not even visit the others, so a partial redraw costs in
+ * proportion to its region. Otherwise the whole buffer is drawn.
+*/
+int triScissoring = 0;
+int triScissor[4] = {0, 0, -1, -1};
+
+/** Confines rendering and clearing to the pixels (i, j) with
+ * xMin <= i <= xMax and yMin <= j <= yMax.
+*/
+void triSetScissor(int xMin, int yMin, int xMax, int yMax){
+    triScissoring = 1;
+    triScissor[0] = xMin;
+    triScissor[1] = yMin;
+    triScissor[2] = xMax;
+    triScissor[3] = yMax;
+}
+
+/** Lets rendering and clearing reach the whole buffer again. */
+void triDisableScissor(void){
+    triScissoring = 0;
+}
+
+/** Sets clip to the pixels of a width x height buffer that may be
+ * drawn, which is the whole buffer cut down to the scissor
+ * rectangle. The clip is empty, with clip[0] > clip[2] or
+ * clip[1] > clip[3], if the scissor lies outside the buffer.
+*/
+void triGetClip(int width, int height, int clip[4]){
+    clip[0] = 0;
+    clip[1] = 0;
+    clip[2] = width - 1;
+    clip[3] = height - 1;
+    if(triScissoring){
+        clip[0] = (triScissor[0] > clip[0]) ? triScissor[0] : clip[0];
+        clip[1] = (triScissor[1] > clip[1]) ? triScissor[1] : clip[1];
+        clip[2] = (triScissor[2] < clip[2]) ? triScissor[2] : clip[2];
+        clip[3] = (triScissor[3] < clip[3]) ? triScissor[3] : clip[3];
+    }
+}
+
+/** Sets the colors of the window and the depths of the buffer,
+ * within the scissor rectangle if there is one. Without a scissor,
+ * this is just pixClearRGB and depthClearDepths. While
+ * multisampling, the samples are cleared instead of the window,
+ * which gets the color when they are resolved.
+*/
+void triClear(depthBuffer *buf, double red, double green, double blue, double depth){
+    int clip[4], i, j;
+    if(!triScissoring){
+        if(triMS != NULL)
+            msClear(triMS, red, green, blue);
+        else
+            pixClearRGB(red, green, blue);
+        depthClearDepths(buf, depth);
+        return;
+    }
+    triGetClip(buf->width, buf->height, clip);
+    if(triMS != NULL){
+        msClearRect(triMS, clip[0], clip[1], clip[2], clip[3], red, green, blue);
+        depthClearDepthsRect(buf, depth, clip[0], clip[1], clip[2], clip[3]);
+        return;
+    }
+    for(j = clip[1]; j <= clip[3]; j++)
+        for(i = clip[0]; i <= clip[2]; i++)
+            pixSetRGB(i, j, red, green, blue);
+    depthClearDepthsRect(buf, depth, clip[0], clip[1], clip[2], clip[3]);
+}
+
+/** Depth-tests a fragment of the given depth at pixel (i, j), as
+ * the current pass does it, and updates the depth buffer. Returns
+ * whether the fragment is kept.
+*/
+int triDepthTestPixel(depthBuffer *buf, int i, int j, double depth){
+    if(triPass == triPASSCOLOR){
+        if(depthTestEqual(buf, i, j, depth) && !depthGetMark(buf, i, j)){
+            depthSetMark(buf, i, j);
+            return 1;
+        }
+        return 0;
+    }
+    return depthTestLess(buf, i, j, depth);
+}
 
 
 /** Does the calculations which result in
@@ -13,17 +188,56 @@
 void renderPixel(int i, int j, const shaShading *sha, depthBuffer *buf, const double unif[], const texTexture *tex[], const double a[], const double m[2][2], const double betaMinusAlpha[], const double gammaMinusAlpha[]){
     const double x[2] = {i, j};
     double xMinusA[2], pAndQ[2], scaledP[sha->varyDim], scaledQ[sha->varyDim], scaledSum[sha->varyDim], chi[sha->varyDim], rgbd[4];
+    statBegin(statFRAGMENT);
     vecSubtract(2, x, a, xMinusA);
     mat221Multiply(m, xMinusA, pAndQ);
     vecScale(sha->varyDim, pAndQ[0], betaMinusAlpha, scaledP);
     vecScale(sha->varyDim, pAndQ[1], gammaMinusAlpha, scaledQ);
     vecAdd(sha->varyDim, scaledP, scaledQ, scaledSum);
     vecAdd(sha->varyDim, scaledSum, a, chi);
-    sha->shadeFragment(sha->unifDim, unif, sha->texNum, tex, sha->varyDim, chi, rgbd);
-    if(rgbd[3] < depthGetDepth(buf, i, j)){
-        depthSetDepth(buf, i, j, rgbd[3]);
+    /*Early-Z: if the shader passes a varying through as its depth,
+    then an occluded pixel need not be shaded at all, and neither
+    need any pixel in a depth or visibility pass.*/
+    int early = (sha->depthVary > 0), pass = 1;
+    int unshaded = early && (triPass == triPASSDEPTH || (triPass == triPASSVISIBILITY && triID >= 0));
+    if(early){
+        statBegin(statDEPTH);
+        pass = triDepthTestPixel(buf, i, j, chi[sha->depthVary]);
+        statEnd(statDEPTH);
+    }
+    if(pass && !unshaded){
+        statCount(statSHADED, 1);
+        triHeatCount(heatSHADED, i, j, 1);
+        shaShadeFragments(sha, unif, tex, 1, chi, rgbd);
+    }
+    statBegin(statDEPTH);
+    if(pass && !early){
+        pass = triDepthTestPixel(buf, i, j, rgbd[3]);
+    }
+    if(!pass){
+        statCount(statDEPTHFAILED, 1);
+        triHeatCount(heatREJECTED, i, j, 1);
+    }
+    else if(unshaded){
+        if(triPass == triPASSVISIBILITY){
+            double r = 1.0 - pAndQ[0] - pAndQ[1];
+            if(triRotation == 1)
+                visSet(triVis, i, j, triID, r, pAndQ[0]);
+            else if(triRotation == 2)
+                visSet(triVis, i, j, triID, pAndQ[1], r);
+            else
+                visSet(triVis, i, j, triID, pAndQ[0], pAndQ[1]);
+        }
+    }
+    else if(triPass != triPASSDEPTH){
         pixSetRGB(i, j, rgbd[0], rgbd[1], rgbd[2]);
+        statCount(statWRITTEN, 1);
+        triHeatCount(heatWRITTEN, i, j, 1);
+        if(triPass == triPASSVISIBILITY)
+            visSet(triVis, i, j, -1, 0.0, 0.0);
     }
+    statEnd(statDEPTH);
+    statEnd(statFRAGMENT);
 }
 
 
@@ -32,11 +246,12 @@ void renderPixel(int i, int j, const shaShading *sha, depthBuffer *buf, const do
 /** Does the basic calculations to interpolate the
  * varyings of a triangle. These calculations are used
  * for every single point in it.
- * Renders the triangle on the screen with the color calculated
- * by the fragment shader.
+ * Renders the part of the triangle within the clip rectangle
+ * with the color calculated by the fragment shader.
+ * Returns 1 if the triangle is culled, and 0 otherwise.
 */
-void triRenderHelper(const shaShading *sha, depthBuffer *buf, const double unif[], const texTexture *tex[], 
-        const double a[], const double b[], const double c[]){
+int triRenderHelper(const shaShading *sha, depthBuffer *buf, const double unif[], const texTexture *tex[], 
+        const double a[], const double b[], const double c[], const int clip[4]){
         int i, j;
 
         /*Declares the basic variables to calculate
@@ -50,7 +265,7 @@ void triRenderHelper(const shaShading *sha, depthBuffer *buf, const double unif[
         mat22Columns(column1, column2, mat);
         /*Prevents the code from drawing triangles which have vertices in clockwse order*/
         if(!(mat22Invert(mat, m) > 0)){
-            return;
+            return 1;
         }
         vecSubtract(sha->varyDim, b, a, betaMinusAlpha);
         vecSubtract(sha->varyDim, c, a, gammaMinusAlpha);
@@ -70,28 +285,28 @@ void triRenderHelper(const shaShading *sha, depthBuffer *buf, const double unif[
                 //Draws the first half of the triangle. 
                 
                 //This makes the code ignore pixels which are out of the window
-                if(ceil(a[0]) < 0){
-                    min = 0;
+                if(ceil(a[0]) < clip[0]){
+                    min = clip[0];
                 }
                 else{
                     min = ceil(a[0]);
                 }
-                if(floor(c[0]) > buf->width){
-                    max = buf->width;
+                if(floor(c[0]) > clip[2]){
+                    max = clip[2];
                 }
                 else{
                     max = floor(c[0]);
                 }
                 for(i = min; i <= max; i++){
                     //This makes the code ignore pixels which are out of the window
-                    if(ceil((a[1] +(((b[1] - a[1])/(b[0] - a[0])) * (i - a[0])))) < 0){
-                        min2 = 0;
+                    if(ceil((a[1] +(((b[1] - a[1])/(b[0] - a[0])) * (i - a[0])))) < clip[1]){
+                        min2 = clip[1];
                     }
                     else{
                         min2 = ceil((a[1] +(((b[1] - a[1])/(b[0] - a[0])) * (i - a[0]))));
                     }
-                    if(floor((a[1]+(((c[1] - a[1])/(c[0] - a[0])) * (i - a[0])))) > buf->height){
-                        max2 = buf->height;
+                    if(floor((a[1]+(((c[1] - a[1])/(c[0] - a[0])) * (i - a[0])))) > clip[3]){
+                        max2 = clip[3];
                     }
                     else{
                         max2 = floor((a[1]+(((c[1] - a[1])/(c[0] - a[0])) * (i - a[0]))));
@@ -102,14 +317,14 @@ void triRenderHelper(const shaShading *sha, depthBuffer *buf, const double unif[
                 }
             }
             //This makes the code ignore pixels which are out of the window
-            if(floor(c[0]) + 1 < 0){
-                min = 0;
+            if(floor(c[0]) + 1 < clip[0]){
+                min = clip[0];
             }
             else{
                 min = floor(c[0]) + 1;
             }
-            if(floor(b[0]) > buf->width){
-                max = buf->width;
+            if(floor(b[0]) > clip[2]){
+                max = clip[2];
             }
             else{
                 max = floor(b[0]);
@@ -117,14 +332,14 @@ void triRenderHelper(const shaShading *sha, depthBuffer *buf, const double unif[
             //Draws the second half of the triangle
             for(i = min; i <= max; i++){
                 //This makes the code ignore pixels which are out of the window
-                if(ceil((a[1] +(((b[1] - a[1])/(b[0] - a[0])) * (i - a[0])))) < 0){
-                    min2 = 0;
+                if(ceil((a[1] +(((b[1] - a[1])/(b[0] - a[0])) * (i - a[0])))) < clip[1]){
+                    min2 = clip[1];
                 }
                 else{
                     min2 = ceil((a[1] +(((b[1] - a[1])/(b[0] - a[0])) * (i - a[0]))));
                 }
-                if(floor((c[1] + (((b[1] - c[1])/(b[0] - c[0])) * (i - c[0])))) > buf->height){
-                    max2 = buf->height;
+                if(floor((c[1] + (((b[1] - c[1])/(b[0] - c[0])) * (i - c[0])))) > clip[3]){
+                    max2 = clip[3];
                 }
                 else{
                     max2 = floor((c[1] + (((b[1] - c[1])/(b[0] - c[0])) * (i - c[0]))));
@@ -144,14 +359,14 @@ void triRenderHelper(const shaShading *sha, depthBuffer *buf, const double unif[
             //Detects possible divisions by 0 and deals with them
             if(!(a[0] == b[0] || a[0] == c[0])){
                 //Optimizes the code by not drawing pixels outside the viewing window
-                if(ceil(a[0]) < 0){
-                    min = 0;
+                if(ceil(a[0]) < clip[0]){
+                    min = clip[0];
                 }
                 else{
                     min = ceil(a[0]);
                 }
-                if(floor(b[0]) > buf->width){
-                    max = buf->width;
+                if(floor(b[0]) > clip[2]){
+                    max = clip[2];
                 }
                 else{
                     max = floor(b[0]);
@@ -159,14 +374,14 @@ void triRenderHelper(const shaShading *sha, depthBuffer *buf, const double unif[
                 //Draws the first half of the triangle
                 for(i = min; i <= max; i++){
                     //Optimizes the code by not drawing pixels which are outside the window
-                    if(ceil((a[1] + (((b[1] - a[1])/(b[0] - a[0])) * (i - a[0])))) < 0){
-                        min2 = 0;
+                    if(ceil((a[1] + (((b[1] - a[1])/(b[0] - a[0])) * (i - a[0])))) < clip[1]){
+                        min2 = clip[1];
                     }
                     else{
                         min2 = ceil((a[1] + (((b[1] - a[1])/(b[0] - a[0])) * (i - a[0]))));
                     }
-                    if(floor((a[1] + (((c[1] - a[1])/(c[0] - a[0])) * (i - a[0])))) > buf->height){
-                        max2 = buf->height;
+                    if(floor((a[1] + (((c[1] - a[1])/(c[0] - a[0])) * (i - a[0])))) > clip[3]){
+                        max2 = clip[3];
                     }
                     else{
                         max2 = floor((a[1] + (((c[1] - a[1])/(c[0] - a[0])) * (i - a[0]))));
@@ -180,28 +395,28 @@ void triRenderHelper(const shaShading *sha, depthBuffer *buf, const double unif[
             if(!(b[0] == c[0])){
                 //Draws the second half of the triangle
                 //Optimizes the code, by not drawing pixels which are outside the viewing window
-                if(floor(b[0]) + 1 < 0){
-                    min = 0;
+                if(floor(b[0]) + 1 < clip[0]){
+                    min = clip[0];
                 }
                 else{
                     min = floor(b[0]) + 1;
                 }
-                if(floor(c[0]) > buf->width){
-                    max = buf->width;
+                if(floor(c[0]) > clip[2]){
+                    max = clip[2];
                 }
                 else{
                     max = floor(c[0]);
                 }
                 for(i = min; i <= max; i++){
                     //This makes the code ignore pixels which are not going to be drawn, making it faster
-                    if(ceil((b[1] + (((c[1] - b[1])/(c[0] - b[0])) * (i - b[0])))) < 0){
-                        min2 = 0;
+                    if(ceil((b[1] + (((c[1] - b[1])/(c[0] - b[0])) * (i - b[0])))) < clip[1]){
+                        min2 = clip[1];
                     }
                     else{
                         min2 = ceil((b[1] + (((c[1] - b[1])/(c[0] - b[0])) * (i - b[0]))));
                     }
-                    if(floor((a[1] + (((c[1] - a[1])/(c[0] - a[0])) * (i - a[0])))) > buf->height){
-                        max2 = buf->height;
+                    if(floor((a[1] + (((c[1] - a[1])/(c[0] - a[0])) * (i - a[0])))) > clip[3]){
+                        max2 = clip[3];
                     }
                     else{
                         max2 = floor((a[1] + (((c[1] - a[1])/(c[0] - a[0])) * (i - a[0]))));
@@ -212,27 +427,830 @@ void triRenderHelper(const shaShading *sha, depthBuffer *buf, const double unif[
                 }
             }
         }
+        return 0;
+}
+
+
+
+/** The rasterizer modes. triCOLUMNS is the original column walk
+ * of triRenderHelper. triEDGES walks rows of the bounding box
+ * with edge functions, so that the barycentric coordinates and
+ * the interpolated varyings advance by constant increments.
+ * triFIXED does the same with integer edge functions on vertices
+ * snapped to a subpixel grid, and a top-left fill rule.
+*/
+#define triCOLUMNS 0
+#define triEDGES 1
+#define triFIXED 2
+
+int triMode = triEDGES;
+int triSubpixelBits = 8;
+
+/** Selects the rasterizer used by triRender. */
+void triSetMode(int mode){
+    triMode = mode;
+}
+
+/** Sets the number of fractional bits in the vertex coordinates of
+ * the triFIXED rasterizer, from 0 to 16.
+*/
+void triSetSubpixelBits(int bits){
+    triSubpixelBits = (bits < 0) ? 0 : ((bits > 16) ? 16 : bits);
+}
+
+/** The edge rasterizer works on blocks of triBLOCKSIZE pixels in a
+ * row, starting at multiples of triBLOCKSIZE, so that a block never
+ * straddles two tiles of the depth buffer. Two kernels act on a
+ * whole block at once: one tests the pixels against the three edge
+ * functions, giving a mask of covered pixels, and one compares the
+ * shaded depths against the depth buffer, giving a mask of pixels
+ * to write. Only covered pixels are shaded. Each kernel has an
+ * AVX2 version, used when the processor supports it, and a scalar
+ * fallback. Bit k of a mask stands for pixel x0 + k of the block.
+*/
+#define triBLOCKSIZE 8
+
+/** Returns the mask of pixels (x0 + k, y) at which the three edge
+ * functions e0[m] + dedx[m] * x + dedy[m] * y are all non-negative.
+*/
+int triCoverBlockScalar(const double e0[3], const double dedx[3], const double dedy[3], int x0, int y){
+    int mask = (1 << triBLOCKSIZE) - 1, k, m;
+    for(m = 0; m < 3; m++){
+        double e = e0[m] + dedy[m] * y;
+        for(k = 0; k < triBLOCKSIZE; k++)
+            if(!(e + dedx[m] * (x0 + k) >= 0.0))
+                mask &= ~(1 << k);
+    }
+    return mask;
+}
+
+/** Compares the depths of the block with the stored depths. Where a
+ * depth is less, stores it and sets the bit of the returned mask.
+ * Pixels that are not covered should have infinite depth.
+*/
+int triDepthBlockScalar(const double depths[triBLOCKSIZE], double stored[triBLOCKSIZE]){
+    int mask = 0, k;
+    for(k = 0; k < triBLOCKSIZE; k++)
+        if(depths[k] < stored[k]){
+            stored[k] = depths[k];
+            mask |= 1 << k;
+        }
+    return mask;
+}
+
+/** The same, for a depth buffer of format depthFLOAT. The depths are
+ * rounded to floats before they are compared.
+*/
+int triDepthBlockFloatScalar(const double depths[triBLOCKSIZE], float stored[triBLOCKSIZE]){
+    int mask = 0, k;
+    for(k = 0; k < triBLOCKSIZE; k++)
+        if((float)depths[k] < stored[k]){
+            stored[k] = (float)depths[k];
+            mask |= 1 << k;
+        }
+    return mask;
+}
+
+/** The same, for a depth buffer of format depthUNORM24 or
+ * depthUNORM32, whose largest integer is max. There is no AVX2
+ * version, because AVX2 has no unsigned 32-bit conversion.
+*/
+int triDepthBlockUnorm(const double depths[triBLOCKSIZE], uint32_t stored[triBLOCKSIZE], double max){
+    int mask = 0, k;
+    uint32_t unorm;
+    for(k = 0; k < triBLOCKSIZE; k++){
+        unorm = depthEncodeUnorm(depths[k], max);
+        if(unorm < stored[k]){
+            stored[k] = unorm;
+            mask |= 1 << k;
+        }
+    }
+    return mask;
+}
+
+#ifdef triAVX2
+__attribute__((target("avx2")))
+int triCoverBlockAVX2(const double e0[3], const double dedx[3], const double dedy[3], int x0, int y){
+    __m256d xLow = _mm256_set_pd(x0 + 3.0, x0 + 2.0, x0 + 1.0, x0);
+    __m256d xHigh = _mm256_add_pd(xLow, _mm256_set1_pd(4.0));
+    __m256d zero = _mm256_setzero_pd();
+    __m256d low = _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), high = low;
+    int m;
+    for(m = 0; m < 3; m++){
+        __m256d e = _mm256_set1_pd(e0[m] + dedy[m] * y);
+        __m256d slope = _mm256_set1_pd(dedx[m]);
+        low = _mm256_and_pd(low, _mm256_cmp_pd(_mm256_add_pd(e, _mm256_mul_pd(slope, xLow)), zero, _CMP_GE_OQ));
+        high = _mm256_and_pd(high, _mm256_cmp_pd(_mm256_add_pd(e, _mm256_mul_pd(slope, xHigh)), zero, _CMP_GE_OQ));
+    }
+    return _mm256_movemask_pd(low) | (_mm256_movemask_pd(high) << 4);
+}
+
+__attribute__((target("avx2")))
+int triDepthBlockAVX2(const double depths[triBLOCKSIZE], double stored[triBLOCKSIZE]){
+    __m256d depthLow = _mm256_loadu_pd(depths), depthHigh = _mm256_loadu_pd(depths + 4);
+    __m256d storedLow = _mm256_loadu_pd(stored), storedHigh = _mm256_loadu_pd(stored + 4);
+    __m256d passLow = _mm256_cmp_pd(depthLow, storedLow, _CMP_LT_OQ);
+    __m256d passHigh = _mm256_cmp_pd(depthHigh, storedHigh, _CMP_LT_OQ);
+    _mm256_storeu_pd(stored, _mm256_blendv_pd(storedLow, depthLow, passLow));
+    _mm256_storeu_pd(stored + 4, _mm256_blendv_pd(storedHigh, depthHigh, passHigh));
+    return _mm256_movemask_pd(passLow) | (_mm256_movemask_pd(passHigh) << 4);
+}
+
+__attribute__((target("avx2")))
+int triDepthBlockFloatAVX2(const double depths[triBLOCKSIZE], float stored[triBLOCKSIZE]){
+    __m256 depth = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(_mm256_loadu_pd(depths))), 
+        _mm256_cvtpd_ps(_mm256_loadu_pd(depths + 4)), 1);
+    __m256 old = _mm256_loadu_ps(stored);
+    __m256 pass = _mm256_cmp_ps(depth, old, _CMP_LT_OQ);
+    _mm256_storeu_ps(stored, _mm256_blendv_ps(old, depth, pass));
+    return _mm256_movemask_ps(pass);
+}
+#endif
+
+int (*triCoverBlock)(const double *, const double *, const double *, int, int) = NULL;
+int (*triDepthBlock)(const double *, double *) = NULL;
+int (*triDepthBlockFloat)(const double *, float *) = NULL;
+
+/** Chooses the block kernels. If useSIMD is nonzero and the processor
+ * supports AVX2, then the AVX2 kernels are used, and otherwise the
+ * scalar ones. Returns whether the AVX2 kernels are in use.
+*/
+int triSetSIMD(int useSIMD){
+    triCoverBlock = triCoverBlockScalar;
+    triDepthBlock = triDepthBlockScalar;
+    triDepthBlockFloat = triDepthBlockFloatScalar;
+#ifdef triAVX2
+    if(useSIMD && __builtin_cpu_supports("avx2")){
+        triCoverBlock = triCoverBlockAVX2;
+        triDepthBlock = triDepthBlockAVX2;
+        triDepthBlockFloat = triDepthBlockFloatAVX2;
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+/** Hierarchical Z. When it is on, triRenderEdges compares the range
+ * of depths that a triangle takes over each tile of the depth buffer
+ * with the bounds that the buffer keeps for the tile (see
+ * depthGetTileMax). A triangle behind every depth of every tile it
+ * touches is rejected whole, and the blocks of a tile that it is
+ * behind are skipped before their coverage is even tested. In a tile
+ * that it is in front of, its blocks are written without comparing
+ * depths. Only shaders that pass their depth through (see depthVary
+ * in 260shading.c) have depths known before shading, and only those
+ * are affected. The image does not change.
+*/
+int triHiZ = 1;
+/* Whether the triangle being rasterized is in front of every depth
+ * of the tile of the current block, so that the block passes the
+ * depth test without a comparison. */
+__thread int triHiZAccept = 0;
+
+/** Turns hierarchical Z on (the default) or off. */
+void triSetHierarchicalZ(int on){
+    triHiZ = on;
+}
+
+/** Returns -1 if a triangle whose depths over the given tile lie
+ * within [lo, hi] is behind every depth stored in the tile, 1 if it
+ * is in front of every one, and 0 otherwise. In triPASSCOLOR, being
+ * in front is no help, so it returns 0 instead of 1.
+*/
+int triHiZClassify(depthBuffer *buf, int tile, double lo, double hi){
+    if(depthQuantize(buf, lo) > depthGetTileMax(buf, tile))
+        return -1;
+    if(triPass != triPASSCOLOR && depthQuantize(buf, hi) < depthGetTileMin(buf, tile))
+        return 1;
+    return 0;
+}
+
+/** Returns whether a triangle whose depths are all at least lo is
+ * behind every depth stored in every tile that the rectangle
+ * {left, bottom, right, top} touches.
+*/
+int triHiZBehind(depthBuffer *buf, double lo, int left, int right, int bottom, int top){
+    double quantized = depthQuantize(buf, lo);
+    int col, row;
+    for(row = bottom / depthTILESIZE; row <= top / depthTILESIZE; row++)
+        for(col = left / depthTILESIZE; col <= right / depthTILESIZE; col++)
+            if(!(quantized > depthGetTileMax(buf, col + buf->tileColNum * row)))
+                return 0;
+    return 1;
+}
+
+/** Sets range to the least and greatest values of the depth
+ * z0 + dzdx * dx + dzdy * dy over the rectangle dx0 <= dx <= dx1,
+ * dy0 <= dy <= dy1. The depth is linear, so they lie at corners.
+*/
+void triHiZBlockRange(double z0, double dzdx, double dzdy, int dx0, int dx1, int dy0, int dy1, double range[2]){
+    range[0] = z0 + fmin(dzdx * dx0, dzdx * dx1) + fmin(dzdy * dy0, dzdy * dy1);
+    range[1] = z0 + fmax(dzdx * dx0, dzdx * dx1) + fmax(dzdy * dy0, dzdy * dy1);
+}
+
+/** Depth-tests the pixels of the mask in the block starting at
+ * pixel (x0, y), as triDepthTestPixel does, and returns the mask of
+ * the pixels kept. The depths of the other pixels should be
+ * infinite. The kernel is chosen by the format of the depth buffer.
+*/
+int triDepthTestBlock(int x0, int y, int mask, depthBuffer *buf, double depths[]){
+    int k, pass = 0;
+    if(triHiZAccept && triPass != triPASSCOLOR){
+        depthSetBlock(buf, x0, y, mask, depths);
+        pass = mask;
+    }
+    else if(triPass != triPASSCOLOR && x0 + triBLOCKSIZE <= buf->width){
+        if(buf->format == depthDOUBLE)
+            pass = triDepthBlock(depths, (double *)depthGetBlock(buf, x0, y));
+        else if(buf->format == depthFLOAT)
+            pass = triDepthBlockFloat(depths, (float *)depthGetBlock(buf, x0, y));
+        else
+            pass = triDepthBlockUnorm(depths, (uint32_t *)depthGetBlock(buf, x0, y), depthUnormMax(buf->format));
+        depthNoteBlock(buf, x0, y, pass, depths);
+    }
+    else{
+        /*The block hangs off the right side of the buffer, or the
+        pass needs the marks.*/
+        for(k = 0; k < triBLOCKSIZE; k++)
+            if((mask & (1 << k)) && triDepthTestPixel(buf, x0 + k, y, depths[k]))
+                pass |= 1 << k;
+    }
+    statCount(statDEPTHFAILED, __builtin_popcount(mask) - __builtin_popcount(pass));
+    triHeatCount(heatREJECTED, x0, y, mask & ~pass);
+    return pass;
+}
+
+/** Shades the covered pixels of the block starting at pixel (x0, y),
+ * and keeps the fragments that pass the depth test. chi holds the
+ * interpolated varyings at pixel (x0, y), and they change by dChidx
+ * per pixel. Likewise bary holds the barycentric coordinates beta
+ * and gamma, which change by dBarydx. The pixels to shade are
+ * packed together and shaded in one call to shaShadeFragments. If
+ * the shader passes a varying through as its depth, then the depth
+ * test comes first, and only the pixels that pass it are shaded, if
+ * the pass shades at all. Otherwise it comes after.
+*/
+void triShadeBlock(int x0, int y, int mask, const shaShading *sha, depthBuffer *buf, const double unif[], const texTexture *tex[], 
+        const double chi[], const double dChidx[], const double bary[2], const double dBarydx[2]){
+    int varyDim = sha->varyDim, depthVary = sha->depthVary, lanes[triBLOCKSIZE], k, m, n, pass, shadedNum = 0;
+    double varys[varyDim * triBLOCKSIZE], rgbds[4 * triBLOCKSIZE], depths[triBLOCKSIZE];
+    statBegin(statFRAGMENT);
+    if(depthVary > 0){
+        statBegin(statDEPTH);
+        for(k = 0; k < triBLOCKSIZE; k++)
+            depths[k] = (mask & (1 << k)) ? chi[depthVary] + dChidx[depthVary] * k : INFINITY;
+        mask = triDepthTestBlock(x0, y, mask, buf, depths);
+        statEnd(statDEPTH);
+        if(triPass == triPASSVISIBILITY && triID >= 0){
+            for(k = 0; k < triBLOCKSIZE; k++)
+                if(mask & (1 << k))
+                    visSet(triVis, x0 + k, y, triID, bary[0] + dBarydx[0] * k, bary[1] + dBarydx[1] * k);
+            statEnd(statFRAGMENT);
+            return;
+        }
+        if(triPass == triPASSDEPTH){
+            statEnd(statFRAGMENT);
+            return;
+        }
+    }
+    for(k = 0; k < triBLOCKSIZE; k++)
+        if(mask & (1 << k))
+            lanes[shadedNum++] = k;
+    if(shadedNum == 0){
+        statEnd(statFRAGMENT);
+        return;
+    }
+    for(m = 0; m < varyDim; m++)
+        for(n = 0; n < shadedNum; n++)
+            varys[m * shadedNum + n] = chi[m] + dChidx[m] * lanes[n];
+    shaShadeFragments(sha, unif, tex, shadedNum, varys, rgbds);
+    statCount(statSHADED, shadedNum);
+    triHeatCount(heatSHADED, x0, y, mask);
+    statBegin(statDEPTH);
+    if(depthVary > 0){
+        pass = mask;
+    }
+    else{
+        for(k = 0; k < triBLOCKSIZE; k++)
+            depths[k] = INFINITY;
+        for(n = 0; n < shadedNum; n++)
+            depths[lanes[n]] = rgbds[3 * shadedNum + n];
+        pass = triDepthTestBlock(x0, y, mask, buf, depths);
+    }
+    if(triPass == triPASSDEPTH)
+        pass = 0;
+    for(n = 0; n < shadedNum; n++)
+        if(pass & (1 << lanes[n])){
+            pixSetRGB(x0 + lanes[n], y, rgbds[n], rgbds[shadedNum + n], rgbds[2 * shadedNum + n]);
+            statCount(statWRITTEN, 1);
+            triHeatCount(heatWRITTEN, x0 + lanes[n], y, 1);
+            if(triPass == triPASSVISIBILITY)
+                visSet(triVis, x0 + lanes[n], y, -1, 0.0, 0.0);
+        }
+    statEnd(statDEPTH);
+    statEnd(statFRAGMENT);
+}
+
+/** Narrows the span [*first, *last] of row y to the pixels where
+ * the edge function e0 + dedx * x + dedy * y is non-negative.
+ * Division gives the bound, and the test on either side of it
+ * corrects any rounding, so the span agrees exactly with the
+ * per-pixel test.
+*/
+void triClipSpan(double e0, double dedx, double dedy, int y, int *first, int *last){
+    double e = e0 + dedy * y, bound;
+    int x;
+    if(dedx > 0.0){
+        bound = fmax(*first - 1.0, fmin(*last + 1.0, ceil(-e / dedx)));
+        x = (int)bound;
+        while(x > *first && e + dedx * (x - 1) >= 0.0)
+            x -= 1;
+        while(x <= *last && e + dedx * x < 0.0)
+            x += 1;
+        if(x > *first)
+            *first = x;
+    }
+    else if(dedx < 0.0){
+        bound = fmax(*first - 1.0, fmin(*last + 1.0, floor(-e / dedx)));
+        x = (int)bound;
+        while(x < *last && e + dedx * (x + 1) >= 0.0)
+            x += 1;
+        while(x >= *first && e + dedx * x < 0.0)
+            x -= 1;
+        if(x < *last)
+            *last = x;
+    }
+    else if(e < 0.0){
+        *last = *first - 1;
+    }
+}
+
+/** Triangles whose bounding boxes span at most triSMALLSIZE pixel
+ * centers in each direction are rasterized by triRenderSmall.
+*/
+#define triSMALLSIZE 2
+
+/** Rasterizes a tiny counterclockwise triangle abc, of twice the
+ * signed area det, within the part {left, bottom, right, top} of
+ * its bounding box that lies in the clip rectangle. Each pixel is
+ * tested as triCoverBlock tests it, so the covered pixels are the
+ * same as in triRenderEdges. But there are no spans and no
+ * increments to set up: the varyings are interpolated only at the
+ * covered pixels, and each one is shaded on its own.
+*/
+void triRenderSmall(const shaShading *sha, depthBuffer *buf, const double unif[], const texTexture *tex[], 
+        const double a[], const double b[], const double c[], double det, int left, int right, int bottom, int top){
+    int varyDim = sha->varyDim, i, j, k;
+    double e0[3] = {b[0] * c[1] - b[1] * c[0], c[0] * a[1] - c[1] * a[0], a[0] * b[1] - a[1] * b[0]};
+    double dedx[3] = {b[1] - c[1], c[1] - a[1], a[1] - b[1]};
+    double dedy[3] = {c[0] - b[0], a[0] - c[0], b[0] - a[0]};
+    double chi[varyDim], zero[varyDim], bary[2], e[3];
+    const double zeroBary[2] = {0.0, 0.0};
+    for(k = 0; k < varyDim; k++)
+        zero[k] = 0.0;
+    for(j = bottom; j <= top; j++){
+        for(i = left; i <= right; i++){
+            for(k = 0; k < 3; k++)
+                e[k] = (e0[k] + dedy[k] * j) + dedx[k] * i;
+            if(!(e[0] >= 0.0 && e[1] >= 0.0 && e[2] >= 0.0))
+                continue;
+            bary[0] = e[1] / det;
+            bary[1] = e[2] / det;
+            for(k = 0; k < varyDim; k++)
+                chi[k] = a[k] + (b[k] - a[k]) * bary[0] + (c[k] - a[k]) * bary[1];
+            /*With no increments, the pixel may sit in any lane of its
+            block.*/
+            triShadeBlock(i - i % triBLOCKSIZE, j, 1 << (i % triBLOCKSIZE), sha, buf, unif, tex, chi, zero, bary, zeroBary);
+        }
+    }
+}
+
+/** Rasterizes the part of the counterclockwise triangle abc within
+ * the clip rectangle with edge functions. A pixel is covered when
+ * its barycentric coordinates are all non-negative. Pixels are
+ * visited row by row, as the framebuffer and the depth buffer are
+ * laid out. The varyings at each pixel are found from constant
+ * increments per row and per pixel, measured from the corner of
+ * the bounding box rather than from the clip rectangle, so that a
+ * pixel gets the same varyings however the triangle is divided
+ * among clip rectangles. Triangles that span at most triSMALLSIZE
+ * pixel centers each way go to triRenderSmall instead. With
+ * hierarchical Z (see triSetHierarchicalZ), each tile of the depth
+ * buffer is classified when a row of blocks first reaches it.
+ * Returns 1 if the triangle is culled, and 0 otherwise.
+*/
+int triRenderEdges(const shaShading *sha, depthBuffer *buf, const double unif[], const texTexture *tex[], 
+        const double a[], const double b[], const double c[], const int clip[4]){
+    int varyDim = sha->varyDim, i, j, k, first, last, mask;
+    double det = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+    /*Prevents the code from drawing triangles which have vertices in clockwise order*/
+    if(!(det > 0.0)){
+        return 1;
+    }
+    if(triCoverBlock == NULL)
+        triSetSIMD(1);
+    /*The bounding box, clipped to the buffer*/
+    int xMin = (int)ceil(fmin(a[0], fmin(b[0], c[0])));
+    int xMax = (int)floor(fmax(a[0], fmax(b[0], c[0])));
+    int yMin = (int)ceil(fmin(a[1], fmin(b[1], c[1])));
+    int yMax = (int)floor(fmax(a[1], fmax(b[1], c[1])));
+    if(xMin < 0)
+        xMin = 0;
+    if(xMax > buf->width - 1)
+        xMax = buf->width - 1;
+    if(yMin < 0)
+        yMin = 0;
+    if(yMax > buf->height - 1)
+        yMax = buf->height - 1;
+    int left = (xMin > clip[0]) ? xMin : clip[0], right = (xMax < clip[2]) ? xMax : clip[2];
+    int bottom = (yMin > clip[1]) ? yMin : clip[1], top = (yMax < clip[3]) ? yMax : clip[3];
+    if(left > right || bottom > top)
+        return 0;
+    /*The depth is linear in x and y, so over the triangle it lies
+    between the depths of the vertices, and over a rectangle between
+    the depths at its corners. The slack covers the rounding of the
+    interpolation.*/
+    int depthVary = sha->depthVary, hiZ = (triHiZ && depthVary > 0 && buf->sampleNum == 1);
+    double zLo = 0.0, zHi = 0.0, dzdx = 0.0, dzdy = 0.0, slack = 0.0;
+    if(hiZ){
+        zLo = fmin(a[depthVary], fmin(b[depthVary], c[depthVary]));
+        zHi = fmax(a[depthVary], fmax(b[depthVary], c[depthVary]));
+        dzdx = ((b[depthVary] - a[depthVary]) * (c[1] - a[1]) + (c[depthVary] - a[depthVary]) * (a[1] - b[1])) / det;
+        dzdy = ((b[depthVary] - a[depthVary]) * (a[0] - c[0]) + (c[depthVary] - a[depthVary]) * (b[0] - a[0])) / det;
+        slack = 1e-9 * (1.0 + fabs(zLo) + fabs(zHi) + fabs(dzdx) * (xMax - xMin + 1) + fabs(dzdy) * (yMax - yMin + 1));
+        if(triHiZBehind(buf, zLo - slack, left, right, bottom, top)){
+            statCount(statHIZCULLED, 1);
+            return 0;
+        }
+    }
+    /*The choice depends on the whole triangle, not on the clip
+    rectangle, so that the pixels are the same however the triangle
+    is divided.*/
+    if(xMax - xMin < triSMALLSIZE && yMax - yMin < triSMALLSIZE){
+        triRenderSmall(sha, buf, unif, tex, a, b, c, det, left, right, bottom, top);
+        return 0;
+    }
+    /*Each edge function is e0 + dedx * x + dedy * y, non-negative on
+    the side of the edge where the triangle is. The edge opposite b is
+    det times beta, and the edge opposite c is det times gamma.*/
+    double eA0 = (b[0] * c[1] - b[1] * c[0]), eAdx = b[1] - c[1], eAdy = c[0] - b[0];
+    double eB0 = (c[0] * a[1] - c[1] * a[0]), eBdx = c[1] - a[1], eBdy = a[0] - c[0];
+    double eC0 = (a[0] * b[1] - a[1] * b[0]), eCdx = a[1] - b[1], eCdy = b[0] - a[0];
+    const double e0[3] = {eA0, eB0, eC0}, dedx[3] = {eAdx, eBdx, eCdx}, dedy[3] = {eAdy, eBdy, eCdy};
+    /*The varyings are chi = a + beta (b - a) + gamma (c - a), so they
+    change by constant amounts per pixel and per row.*/
+    double dChidx[varyDim], dChidy[varyDim], chiMin[varyDim], chiRow[varyDim], chi[varyDim], bary[2];
+    double dBetadx = eBdx / det, dBetady = eBdy / det;
+    double dGammadx = eCdx / det, dGammady = eCdy / det;
+    double beta = (eB0 + eBdx * xMin + eBdy * yMin) / det;
+    double gamma = (eC0 + eCdx * xMin + eCdy * yMin) / det;
+    for(k = 0; k < varyDim; k++){
+        dChidx[k] = (b[k] - a[k]) * dBetadx + (c[k] - a[k]) * dGammadx;
+        dChidy[k] = (b[k] - a[k]) * dBetady + (c[k] - a[k]) * dGammady;
+        chiMin[k] = a[k] + (b[k] - a[k]) * beta + (c[k] - a[k]) * gamma;
+    }
+    const double dBarydx[2] = {dBetadx, dGammadx};
+    /*The classes of the tiles of the current row of tiles, as
+    triHiZClassify gives them, or 2 for tiles not yet classified.*/
+    int tileLeft = left / depthTILESIZE, blockLeft, blockRight, tileBottom, tileTop;
+    signed char hiZClasses[right / depthTILESIZE - tileLeft + 1];
+    double range[2];
+    for(j = bottom; j <= top; j++){
+        if(hiZ && (j == bottom || j % depthTILESIZE == 0))
+            for(k = 0; k <= right / depthTILESIZE - tileLeft; k++)
+                hiZClasses[k] = 2;
+        for(k = 0; k < varyDim; k++)
+            chiRow[k] = chiMin[k] + dChidy[k] * (j - yMin);
+        first = left;
+        last = right;
+        triClipSpan(eA0, eAdx, eAdy, j, &first, &last);
+        triClipSpan(eB0, eBdx, eBdy, j, &first, &last);
+        triClipSpan(eC0, eCdx, eCdy, j, &first, &last);
+        /*The span picks out the blocks to visit, with a pixel to spare
+        on either side, and the coverage kernel picks out the pixels
+        within them.*/
+        first = (first > left) ? first - 1 : left;
+        last = (last < right) ? last + 1 : right;
+        for(i = first - first % triBLOCKSIZE; i <= last; i += triBLOCKSIZE){
+            if(hiZ){
+                /*A block lies in one tile, whose part within the clip
+                rectangle and the bounding box gives the corners.*/
+                k = i / depthTILESIZE - tileLeft;
+                if(hiZClasses[k] == 2){
+                    blockLeft = (i > left) ? i : left;
+                    blockRight = (i + triBLOCKSIZE - 1 < right) ? i + triBLOCKSIZE - 1 : right;
+                    tileBottom = j - j % depthTILESIZE;
+                    tileTop = tileBottom + depthTILESIZE - 1;
+                    tileBottom = (tileBottom > bottom) ? tileBottom : bottom;
+                    tileTop = (tileTop < top) ? tileTop : top;
+                    triHiZBlockRange(chiMin[depthVary], dzdx, dzdy, blockLeft - xMin, blockRight - xMin,
+                        tileBottom - yMin, tileTop - yMin, range);
+                    hiZClasses[k] = triHiZClassify(buf, depthTile(buf, i, j), fmax(range[0], zLo) - slack, fmin(range[1], zHi) + slack);
+                    if(hiZClasses[k] < 0)
+                        statCount(statHIZTILES, 1);
+                }
+                if(hiZClasses[k] < 0)
+                    continue;
+                triHiZAccept = hiZClasses[k];
+            }
+            mask = triCoverBlock(e0, dedx, dedy, i, j);
+            if(i < left)
+                mask &= ~((1u << (left - i)) - 1u);
+            if(i + triBLOCKSIZE - 1 > right)
+                mask &= (1 << (right - i + 1)) - 1;
+            if(mask != 0){
+                for(k = 0; k < varyDim; k++)
+                    chi[k] = chiRow[k] + dChidx[k] * (i - xMin);
+                bary[0] = beta + dBetady * (j - yMin) + dBetadx * (i - xMin);
+                bary[1] = gamma + dGammady * (j - yMin) + dGammadx * (i - xMin);
+                triShadeBlock(i, j, mask, sha, buf, unif, tex, chi, dChidx, bary, dBarydx);
+            }
+        }
+    }
+    triHiZAccept = 0;
+    return 0;
+}
+
+
+
+/** Rasterizes the part of the counterclockwise triangle abc within
+ * the clip rectangle with integer edge
+ * functions. The vertices are snapped to a grid of 2^triSubpixelBits
+ * steps per pixel, and the edge functions are evaluated exactly in
+ * 64-bit integers, with no divisions. A pixel that lies exactly on
+ * an edge belongs to the triangle only if the edge is a top edge
+ * (horizontal, with the triangle below it) or a left edge (with the
+ * triangle to its right). Two triangles that share an edge traverse
+ * it in opposite directions, so exactly one of them claims each
+ * pixel on it. The varyings are interpolated in doubles, using one
+ * reciprocal of the area. Triangles too large for the integers fall
+ * back to triRenderEdges. Returns 1 if the triangle is culled, and
+ * 0 otherwise.
+*/
+int triRenderFixed(const shaShading *sha, depthBuffer *buf, const double unif[], const texTexture *tex[], 
+        const double a[], const double b[], const double c[], const int clip[4]){
+    int bits = triSubpixelBits, varyDim = sha->varyDim, i, j, k, m, mask, found;
+    long long one = 1LL << bits;
+    /*Keeping coordinates below 2^30 subpixels keeps every product of
+    differences below 2^62.*/
+    double scale = (double)one, limit = (double)(1LL << (30 - bits));
+    if(!(fabs(a[0]) < limit && fabs(a[1]) < limit && fabs(b[0]) < limit &&
+            fabs(b[1]) < limit && fabs(c[0]) < limit && fabs(c[1]) < limit)){
+        return triRenderEdges(sha, buf, unif, tex, a, b, c, clip);
+    }
+    long long x[3] = {llround(a[0] * scale), llround(b[0] * scale), llround(c[0] * scale)};
+    long long y[3] = {llround(a[1] * scale), llround(b[1] * scale), llround(c[1] * scale)};
+    long long det = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    /*Prevents the code from drawing triangles which have vertices in clockwise order*/
+    if(det <= 0){
+        return 1;
+    }
+    if(triCoverBlock == NULL)
+        triSetSIMD(1);
+    /*The bounding box, rounded inward to whole pixels and clipped to
+    the clip rectangle. The edge functions are exact, so they can
+    start from any pixel.*/
+    long long xLow = x[0], xHigh = x[0], yLow = y[0], yHigh = y[0];
+    for(m = 1; m < 3; m++){
+        xLow = (x[m] < xLow) ? x[m] : xLow;
+        xHigh = (x[m] > xHigh) ? x[m] : xHigh;
+        yLow = (y[m] < yLow) ? y[m] : yLow;
+        yHigh = (y[m] > yHigh) ? y[m] : yHigh;
+    }
+    int xMin = (int)((xLow + one - 1) >> bits), xMax = (int)(xHigh >> bits);
+    int yMin = (int)((yLow + one - 1) >> bits), yMax = (int)(yHigh >> bits);
+    if(xMin < clip[0])
+        xMin = clip[0];
+    if(xMax > clip[2])
+        xMax = clip[2];
+    if(yMin < clip[1])
+        yMin = clip[1];
+    if(yMax > clip[3])
+        yMax = clip[3];
+    if(xMin > xMax || yMin > yMax)
+        return 0;
+    /*Edge m runs from vertex m + 1 to vertex m + 2, opposite vertex
+    m, so that its function at a pixel is det times the barycentric
+    coordinate of vertex m there. It changes by stepX per pixel to
+    the right and stepY per pixel up. bias is -1 on edges that are
+    neither top nor left, so that a zero there fails the test.*/
+    long long row[3], stepX[3], stepY[3], bias[3], w[3];
+    for(m = 0; m < 3; m++){
+        int from = (m + 1) % 3, to = (m + 2) % 3;
+        long long dx = x[to] - x[from], dy = y[to] - y[from];
+        row[m] = dx * (yMin * one - y[from]) - dy * (xMin * one - x[from]);
+        stepX[m] = -dy * one;
+        stepY[m] = dx * one;
+        bias[m] = (dy < 0 || (dy == 0 && dx < 0)) ? 0 : -1;
+    }
+    double invDet = 1.0 / (double)det;
+    double dChidx[varyDim], chi[varyDim];
+    const double dBarydx[2] = {stepX[1] * invDet, stepX[2] * invDet};
+    for(k = 0; k < varyDim; k++)
+        dChidx[k] = ((b[k] - a[k]) * stepX[1] + (c[k] - a[k]) * stepX[2]) * invDet;
+    for(j = yMin; j <= yMax; j++){
+        found = 0;
+        for(i = xMin - xMin % triBLOCKSIZE; i <= xMax; i += triBLOCKSIZE){
+            for(m = 0; m < 3; m++)
+                w[m] = row[m] + stepX[m] * (i - xMin);
+            mask = 0;
+            for(k = 0; k < triBLOCKSIZE; k++){
+                if(i + k >= xMin && i + k <= xMax &&
+                        ((w[0] + bias[0]) | (w[1] + bias[1]) | (w[2] + bias[2])) >= 0)
+                    mask |= 1 << k;
+                for(m = 0; m < 3; m++)
+                    w[m] += stepX[m];
+            }
+            if(mask == 0){
+                /*The triangle is convex, so once a row has been
+                entered and left, the rest of it is empty.*/
+                if(found)
+                    break;
+                continue;
+            }
+            found = 1;
+            double beta = (row[1] + stepX[1] * (i - xMin)) * invDet;
+            double gamma = (row[2] + stepX[2] * (i - xMin)) * invDet;
+            const double bary[2] = {beta, gamma};
+            for(k = 0; k < varyDim; k++)
+                chi[k] = a[k] + (b[k] - a[k]) * beta + (c[k] - a[k]) * gamma;
+            triShadeBlock(i, j, mask, sha, buf, unif, tex, chi, dChidx, bary, dBarydx);
+        }
+        for(m = 0; m < 3; m++)
+            row[m] += stepY[m];
+    }
+    return 0;
+}
+
+
+
+/** Rasterizes the part of the counterclockwise triangle abc within
+ * the clip rectangle into the multisample buffer triMS. A pixel is
+ * touched if any of its msSAMPLENUM samples lies in the triangle,
+ * by the edge test of triRenderEdges. Then the fragment shader
+ * runs once, with the varyings at the pixel's center, even if the
+ * center itself lies outside the triangle. If the shader passes a
+ * varying through as its depth, then each covered sample is
+ * depth-tested first, at its own position, and the shader runs
+ * only if some sample passes. Otherwise every covered sample is
+ * tested against the shaded depth. The color goes to the samples
+ * that pass. Returns 1 if the triangle is culled, and 0 otherwise.
+*/
+int triRenderMultisample(const shaShading *sha, depthBuffer *buf, const double unif[], const texTexture *tex[], 
+        const double a[], const double b[], const double c[], const int clip[4]){
+    int varyDim = sha->varyDim, depthVary = sha->depthVary, i, j, k, s, mask, pass;
+    double det = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+    /*Prevents the code from drawing triangles which have vertices in clockwise order*/
+    if(!(det > 0.0)){
+        return 1;
+    }
+    /*The bounding box, widened by the farthest sample offset*/
+    int left = (int)ceil(fmin(a[0], fmin(b[0], c[0])) - 0.375);
+    int right = (int)floor(fmax(a[0], fmax(b[0], c[0])) + 0.375);
+    int bottom = (int)ceil(fmin(a[1], fmin(b[1], c[1])) - 0.375);
+    int top = (int)floor(fmax(a[1], fmax(b[1], c[1])) + 0.375);
+    left = (left > clip[0]) ? left : clip[0];
+    right = (right < clip[2]) ? right : clip[2];
+    bottom = (bottom > clip[1]) ? bottom : clip[1];
+    top = (top < clip[3]) ? top : clip[3];
+    if(left > right || bottom > top)
+        return 0;
+    double e0[3] = {b[0] * c[1] - b[1] * c[0], c[0] * a[1] - c[1] * a[0], a[0] * b[1] - a[1] * b[0]};
+    double dedx[3] = {b[1] - c[1], c[1] - a[1], a[1] - b[1]};
+    double dedy[3] = {c[0] - b[0], a[0] - c[0], b[0] - a[0]};
+    double chi[varyDim], rgbd[4], bary[2], dDepth[msSAMPLENUM], depths[msSAMPLENUM];
+    /*The depth varying changes by a constant amount per unit in x
+    and in y, which gives its value at each sample.*/
+    if(depthVary > 0)
+        for(s = 0; s < msSAMPLENUM; s++)
+            dDepth[s] = ((b[depthVary] - a[depthVary]) * (dedx[1] * msOffsets[s][0] + dedy[1] * msOffsets[s][1]) + 
+                (c[depthVary] - a[depthVary]) * (dedx[2] * msOffsets[s][0] + dedy[2] * msOffsets[s][1])) / det;
+    for(j = bottom; j <= top; j++){
+        for(i = left; i <= right; i++){
+            mask = 0;
+            for(s = 0; s < msSAMPLENUM; s++){
+                double x = i + msOffsets[s][0], y = j + msOffsets[s][1];
+                if((e0[0] + dedy[0] * y) + dedx[0] * x >= 0.0 && 
+                        (e0[1] + dedy[1] * y) + dedx[1] * x >= 0.0 && 
+                        (e0[2] + dedy[2] * y) + dedx[2] * x >= 0.0)
+                    mask |= 1 << s;
+            }
+            if(mask == 0)
+                continue;
+            statBegin(statFRAGMENT);
+            bary[0] = ((e0[1] + dedy[1] * j) + dedx[1] * i) / det;
+            bary[1] = ((e0[2] + dedy[2] * j) + dedx[2] * i) / det;
+            for(k = 0; k < varyDim; k++)
+                chi[k] = a[k] + (b[k] - a[k]) * bary[0] + (c[k] - a[k]) * bary[1];
+            pass = 0;
+            if(depthVary > 0){
+                statBegin(statDEPTH);
+                for(s = 0; s < msSAMPLENUM; s++)
+                    depths[s] = chi[depthVary] + dDepth[s];
+                pass = depthTestSamples(buf, i, j, mask, depths);
+                statEnd(statDEPTH);
+                if(pass == 0){
+                    statCount(statDEPTHFAILED, 1);
+                    triHeatCount(heatREJECTED, i, j, 1);
+                    statEnd(statFRAGMENT);
+                    continue;
+                }
+            }
+            shaShadeFragments(sha, unif, tex, 1, chi, rgbd);
+            statCount(statSHADED, 1);
+            triHeatCount(heatSHADED, i, j, 1);
+            statBegin(statDEPTH);
+            if(depthVary <= 0){
+                for(s = 0; s < msSAMPLENUM; s++)
+                    depths[s] = rgbd[3];
+                pass = depthTestSamples(buf, i, j, mask, depths);
+            }
+            if(pass != 0){
+                msSetSamples(triMS, i, j, pass, rgbd);
+                statCount(statWRITTEN, 1);
+                triHeatCount(heatWRITTEN, i, j, 1);
+            }
+            else{
+                statCount(statDEPTHFAILED, 1);
+                triHeatCount(heatREJECTED, i, j, 1);
+            }
+            statEnd(statDEPTH);
+            statEnd(statFRAGMENT);
+        }
+    }
+    return 0;
 }
 
+/** Returns whether the bounding box of the triangle abc contains no
+ * pixel center within the clip rectangle, in which case the
+ * triangle covers no pixel there, by any rule but that of
+ * triRenderFixed, which snaps the vertices first.
+*/
+int triMissesPixels(const double a[], const double b[], const double c[], const int clip[4]){
+    return ceil(fmax(fmin(a[0], fmin(b[0], c[0])), clip[0])) > fmin(fmax(a[0], fmax(b[0], c[0])), clip[2]) ||
+        ceil(fmax(fmin(a[1], fmin(b[1], c[1])), clip[1])) > fmin(fmax(a[1], fmax(b[1], c[1])), clip[3]);
+}
 
+/** Renders the part of the triangle within the clip rectangle
+ * {xMin, yMin, xMax, yMax}, in whole pixels with the bounds
+ * included, using the rasterizer chosen by triSetMode, or the
+ * multisample rasterizer if triSetMultisample is in effect. A pixel
+ * gets the same color whether the triangle is drawn whole or in
+ * pieces, so that the screen can be divided among threads. Returns
+ * 1 if the triangle is culled, and 0 otherwise, but does not count
+ * it in the statistics, which is up to the caller.
+*/
+int triRenderClipped(
+        const shaShading *sha, depthBuffer *buf, const double unif[], 
+        const texTexture *tex[], const double a[], const double b[], 
+        const double c[], const int clip[4]) {
+    if(triMS != NULL && buf->sampleNum == msSAMPLENUM){
+        return triRenderMultisample(sha, buf, unif, tex, a, b, c, clip);
+    }
+    else if(triMode == triEDGES){
+        return triRenderEdges(sha, buf, unif, tex, a, b, c, clip);
+    }
+    else if(triMode == triFIXED){
+        return triRenderFixed(sha, buf, unif, tex, a, b, c, clip);
+    }
+    else if(triMissesPixels(a, b, c, clip)){
+        /*The column walk would invert a matrix before finding nothing
+        to draw, so such triangles are rejected first.*/
+        return !((b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]) > 0.0);
+    }
+    else if(a[0] <= b[0] && a[0] <= c[0]){
+        triRotation = 0;
+        return triRenderHelper(sha, buf, unif, tex, a, b, c, clip);
+    }
+    else if(b[0] <= c[0] && b[0] <= a[0]){
+        triRotation = 1;
+        return triRenderHelper(sha, buf, unif, tex, b, c, a, clip);
+    }
+    else{
+        triRotation = 2;
+        return triRenderHelper(sha, buf, unif, tex, c, a, b, clip);
+    }
+}
 
 /** Receives the coordinates of the vertices of a triangle
  * in counterclockwise direction, and arrays with information
  * about vertices, textures and uniform data. Calls helper functions
- * to render it on the screen.
+ * to render it on the screen, within the scissor rectangle.
 */
 void triRender(
         const shaShading *sha, depthBuffer *buf, const double unif[], 
         const texTexture *tex[], const double a[], const double b[], 
         const double c[]) {
-    if(a[0] <= b[0] && a[0] <= c[0]){
-        triRenderHelper(sha, buf, unif, tex, a, b, c);
+    int clip[4];
+    triGetClip(buf->width, buf->height, clip);
+    statBegin(statSETUP);
+    if(triRenderClipped(sha, buf, unif, tex, a, b, c, clip)){
+        statCount(statCULLED, 1);
     }
-    else if(b[0] <= c[0] && b[0] <= a[0])
-        triRenderHelper(sha, buf, unif, tex, b, c, a);
     else{
-        triRenderHelper(sha, buf, unif, tex, c, a, b);
+        statCount(statRASTERIZED, 1);
     }
+    statEnd(statSETUP);
 }
 
 
@@ -23,9 +23,14 @@ On Ubuntu, compile with...
 
 #include "250vector.c"
 #include "280matrix.c"
+#include "390trace.c"
 #include "150texture.c"
 #include "260depth.c"
 #include "260shading.c"
+#include "380stats.c"
+#include "410visibility.c"
+#include "430multisample.c"
+#include "440heat.c"
 #include "270triangle.c"
 #include "280mesh.c"
 #include "190mesh2D.c"
@@ -277,4 +277,20 @@ void mat44InverseViewport(double width, double height, double view[4][4]){
     view[2][2] = 2.0;
     view[2][3] = -1.0;
     view[3][3] = 1.0;
-}
\ No newline at end of file
+}
+
+/* Like mat44Viewport, but maps the viewing volume to the width x height 
+rectangle of the screen whose lower left corner is at (x, y), as in split views 
+and insets. */
+void mat44ViewportRect(double x, double y, double width, double height, double view[4][4]){
+    mat44Viewport(width, height, view);
+    view[0][3] += x;
+    view[1][3] += y;
+}
+
+/* Inverse to the matrix produced by mat44ViewportRect. */
+void mat44InverseViewportRect(double x, double y, double width, double height, double view[4][4]){
+    mat44InverseViewport(width, height, view);
+    view[0][3] -= 2.0 * x / width;
+    view[1][3] -= 2.0 * y / height;
+}
@@ -17,9 +17,14 @@ On Ubuntu, compile with...
 
 #include "250vector.c"
 #include "280matrix.c"
+#include "390trace.c"
 #include "150texture.c"
 #include "260shading.c"
 #include "260depth.c"
+#include "380stats.c"
+#include "410visibility.c"
+#include "430multisample.c"
+#include "440heat.c"
 #include "270triangle.c"
 #include "330mesh.c"
 #include "190mesh2D.c"
@@ -98,14 +103,23 @@ double unif[16 + 16] = {
 double viewport[4][4];
 camCamera cam;
 double angle = M_PI * 0.25;
+/* The kind of heat count shown in place of the scene, or -1 for the scene. */
+heatBuffer heat;
+int heatKind = -1;
 
 void render(void) {
+	traceBegin("render");
+	if (heatKind >= 0)
+		heatClear(&heat);
 	pixClearRGB(0.8, 0.8, 1.0);
 	depthClearDepths(&buf, 1000000000.0);
 	double projInvIsom[4][4];
 	camGetProjectionInverseIsometry(&cam, projInvIsom);
     vecCopy(16, (double *)projInvIsom, &unif[UNIFPROJINVISOM]);
 	meshRender(&landMesh, &buf, viewport, &sha, unif, tex);
+	if (heatKind >= 0)
+		heatShow(&heat, heatKind, 8);
+	traceEnd();
 }
 
 void handleKeyUp(
@@ -122,6 +136,14 @@ void handleKeyUp(
 		else
 		    camSetProjectionType(&cam, camORTHOGRAPHIC);
         camSetFrustum(&cam, M_PI / 6.0, 10.0, 10.0, 512, 512);
+	} else if (key == GLFW_KEY_T)
+		/* With -DTRACE, saves the recent timeline for a trace viewer. */
+		traceExport("landscape.json");
+	else if (key == GLFW_KEY_H) {
+		/* Cycles through the scene and the heat maps of fragments shaded, 
+		rejected by depth, and written. */
+		heatKind = (heatKind + 2) % (heatKINDNUM + 1) - 1;
+		triSetHeatMap((heatKind >= 0) ? &heat : NULL);
 	}
 }
 
@@ -173,13 +195,20 @@ int main(void) {
 	    pixFinalize();
 		return 5;
 	}
+	if (heatInitialize(&heat, 512, 512) != 0) {
+	    depthFinalize(&buf);
+	    pixFinalize();
+		return 5;
+	}
 	if (texInitializeFile(&texture, "awesome.png") != 0) {
+	    heatFinalize(&heat);
 	    depthFinalize(&buf);
 	    pixFinalize();
 		return 2;
 	}
 	if (mesh3DInitializeLandscape(&landMesh, LANDSIZE, 1.0, landData) != 0) {
 	    texFinalize(&texture);
+	    heatFinalize(&heat);
 	    depthFinalize(&buf);
 	    pixFinalize();
 		return 3;
@@ -220,6 +249,7 @@ int main(void) {
     /* Clean up. */
     meshFinalize(&landMesh);
     texFinalize(&texture);
+    heatFinalize(&heat);
     depthFinalize(&buf);
     pixFinalize();
     return 0;
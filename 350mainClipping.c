@@ -17,10 +17,17 @@ On Ubuntu, compile with...
 
 #include "250vector.c"
 #include "280matrix.c"
+#include "390trace.c"
 #include "150texture.c"
 #include "260shading.c"
 #include "260depth.c"
+#include "380stats.c"
+#include "410visibility.c"
+#include "430multisample.c"
+#include "440heat.c"
 #include "270triangle.c"
+#include "400bin.c"
+#include "420deferred.c"
 #include "350mesh.c"
 #include "190mesh2D.c"
 #include "250mesh3D.c"
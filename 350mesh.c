@@ -220,13 +220,24 @@ void meshRenderFinal(depthBuffer *buf, const double viewport[4][4], const shaSha
 	vecScale(sha->varyDim,1.0/viewportA[3], a, a);
 	vecScale(sha->varyDim,1.0/viewportB[3], b, b);
 	vecScale(sha->varyDim,1.0/viewportC[3], c, c);
-	triRender(sha, buf, unif, tex, a, b, c);
+	if(triPass == triPASSVISIBILITY){
+		defTriangle(sha, a, b, c);
+	}
+	if(binThreadNum > 1){
+		binTriangle(sha, buf, unif, tex, a, b, c);
+	}
+	else{
+		triRender(sha, buf, unif, tex, a, b, c);
+	}
 }
 
 void meshClipping(depthBuffer *buf, const double viewport[4][4], const shaShading *sha, const double unif[], const texTexture *tex[], double a[], double b[], double c[]){
 	int aClip = meshClippingHelper(a);
  	int bClip = meshClippingHelper(b);
 	int cClip = meshClippingHelper(c);
+	if(aClip || bClip || cClip){
+		statCount(statCLIPPED, 1);
+	}
 	if(aClip && bClip && cClip){
 		return;
 	}
@@ -274,28 +285,54 @@ void meshClipping(depthBuffer *buf, const double viewport[4][4], const shaShadin
 	}
 }
 
+/* The number of triangles in each span that meshRender records for tracing. */
+#define meshTRACEBATCH 256
+
 /* Renders the mesh. If the mesh and the shading have differing values for 
-attrDim, then prints an error message and does not render anything. */
+attrDim, then prints an error message and does not render anything. If 
+binSetThreadNum has asked for more than one thread, then the triangles are 
+binned as they come, and rasterized on all of the threads at the end. Between 
+defBegin and defEnd, the triangles are recorded for deferred shading. */
 void meshRender(
         const meshMesh *mesh, depthBuffer *buf, const double viewport[4][4], 
         const shaShading *sha, const double unif[], const texTexture *tex[]) {
 	int *triangle;
 	double *a, *b, *c, varyA[sha->varyDim], varyB[sha->varyDim], varyC[sha->varyDim];
+	traceBegin("meshRender");
 	if(mesh->attrDim == sha->attrDim){
+		if(triPass == triPASSVISIBILITY){
+			defMesh(sha, unif, tex);
+		}
 		for(int i = 0; i < mesh->triNum; i++){
+			if(i % meshTRACEBATCH == 0){
+				if(i > 0){
+					traceEnd();
+				}
+				traceBegin("triRender batch");
+			}
 			triangle = meshGetTrianglePointer(mesh, i);
 			a = meshGetVertexPointer(mesh, triangle[0]);
 			b = meshGetVertexPointer(mesh, triangle[1]);
 			c = meshGetVertexPointer(mesh, triangle[2]);
+			statCount(statSUBMITTED, 1);
+			statBegin(statVERTEX);
 			sha->shadeVertex(sha->unifDim, unif, sha->attrDim, a, sha->varyDim, varyA);
 			sha->shadeVertex(sha->unifDim, unif, sha->attrDim, b, sha->varyDim, varyB);
 			sha->shadeVertex(sha->unifDim, unif, sha->attrDim, c, sha->varyDim, varyC);
+			statEnd(statVERTEX);
+			statBegin(statCLIP);
 			meshClipping(buf, viewport, sha, unif, tex, varyA, varyB, varyC);
+			statEnd(statCLIP);
+		}
+		if(mesh->triNum > 0){
+			traceEnd();
 		}
+		binFlush(sha, buf, unif, tex);
 	}
 	else{
 		printf("Error: the number of attributes in mesh does not match the numbers of attributes on triangle!");
 	}
+	traceEnd();
 }
 
 
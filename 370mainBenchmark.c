@@ -0,0 +1,783 @@
+/* On macOS or Linux, compile with...
+    cc -O2 370mainBenchmark.c 040pixelHeadless.c -lm -lpthread
+and run with...
+    ./a.out [scene] [frameNum] [rasterizer] [threadNum] [shading] [depthTest]
+        [antialiasing] [heatMap] [depthFormat] [hiZ] [depthLayout]
+where scene is 3d, world, landscape, clipping, or all (the default),
+frameNum is the number of timed frames per scene (default 120), rasterizer
+is edges (the default), columns, or fixed, as in triSetMode, threadNum is
+the number of threads that rasterize, as in binSetThreadNum (default 1), and
+shading is batched (the default), to give the rasterizer the shadeFragments
+entry points, pixel, to make it shade one fragment per call, or deferred, to
+render into a visibility buffer and shade each pixel once afterward, as in
+420deferred.c, and depthTest is early (the default), to declare that the
+shaders pass their depth through so that occluded fragments are never shaded,
+late, or prepass, to render each frame twice, first writing only depths and
+then shading only the visible fragments, as in triSetPass, and antialiasing
+is none (the default), msaa, to render with four samples per pixel, as in
+430multisample.c, and resolve them at the end of each frame, or msaa-present,
+to resolve them as each frame is presented, outside the timed rendering, and
+heatMap is none (the default), or shaded, rejected, or written, to replace each
+frame with a false-color image of how many fragments were shaded, failed the
+depth test, or were written at each pixel, as in 440heat.c, and depthFormat is
+double (the default), float, unorm24, or unorm32, to store depths as in
+depthInitializeFormat, and hiZ is on (the default) or off, to use hierarchical
+Z as in triSetHierarchicalZ, and depthLayout is linear (the default) or tiled,
+to lay out depths as in depthInitializeLayout. */
+
+/* This program renders the scenes of 250main3D.c, 290mainWorld.c,
+340mainLandscape.c, and 350mainClipping.c without a window, and reports how
+fast it renders them. Each scene is ported to the newest modules, so that the
+benchmark measures the renderer as it is now. Nothing depends on the clock or
+on user input: the landscapes are generated from a fixed seed, and the meshes
+and cameras follow scripted paths indexed by frame number. So two runs render
+exactly the same pixels, and the checksum in the report confirms it.
+
+For each scene, the program prints one line of JSON to stdout, holding the
+mean, median, and 99th percentile milliseconds per frame (for rendering, not
+presenting), the triangles submitted per second, the fragments shaded per
+second, the total vertex and fragment shader invocations, and a checksum of
+the final frame. If the program is compiled with -DSTATS, then the line also
+holds the per-frame means of the counters and stage timers of 380stats.c. If it
+is compiled with -DTRACE, then it writes the timeline of the last frames, as
+recorded by 390trace.c, to benchmark.json. */
+
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "040pixel.h"
+
+#include "250vector.c"
+#include "280matrix.c"
+#include "390trace.c"
+#include "150texture.c"
+#include "260shading.c"
+#include "260depth.c"
+#include "380stats.c"
+#include "410visibility.c"
+#include "430multisample.c"
+#include "440heat.c"
+#include "270triangle.c"
+#include "400bin.c"
+#include "420deferred.c"
+#include "350mesh.c"
+#include "190mesh2D.c"
+#include "250mesh3D.c"
+#include "300isometry.c"
+#include "300camera.c"
+#include "340landscape.c"
+
+#define WINDOWW 512
+#define WINDOWH 512
+#define LANDSIZE 40
+#define LANDSEED 311
+#define WARMUPNUM 8
+
+#define ATTRX 0
+#define ATTRY 1
+#define ATTRZ 2
+#define ATTRS 3
+#define ATTRT 4
+#define ATTRN 5
+#define ATTRO 6
+#define ATTRP 7
+#define VARYX 0
+#define VARYY 1
+#define VARYZ 2
+#define VARYW 3
+#define VARYS 4
+#define VARYT 5
+#define VARYV 4
+#define VARYLANDS 5
+#define VARYLANDT 6
+#define VARYN 7
+#define VARYO 8
+#define VARYP 9
+#define UNIFR 0
+#define UNIFG 1
+#define UNIFB 2
+#define UNIFMODELING 3
+#define UNIFPROJINVISOM 19
+#define TEXR 0
+#define TEXG 1
+#define TEXB 2
+
+/* Shader invocations, counted by the shaders themselves. Fragment shaders run
+on several threads, so each thread counts in its own row, which fills a cache
+line, and the rows are summed for the report. */
+long benchVertexNum = 0, benchFragmentNums[binTHREADMAX][8];
+
+
+
+/*** Shaders ***/
+
+/* The box shaders, from 250main3D.c and 290mainWorld.c. The texture is
+modulated by the uniform color. */
+void shadeVertexBox(
+        int unifDim, const double unif[], int attrDim, const double attr[],
+        int varyDim, double vary[]) {
+	double attrHomog[4] = {attr[ATTRX], attr[ATTRY], attr[ATTRZ], 1.0};
+	double modHomog[4];
+	benchVertexNum += 1;
+	mat441Multiply((double(*)[4])(&unif[UNIFMODELING]), attrHomog, modHomog);
+	mat441Multiply((double(*)[4])(&unif[UNIFPROJINVISOM]), modHomog, vary);
+	vary[VARYS] = attr[ATTRS];
+	vary[VARYT] = attr[ATTRT];
+}
+
+void shadeFragmentBox(
+        int unifDim, const double unif[], int texNum, const texTexture *tex[],
+        int varyDim, const double vary[], double rgbd[4]) {
+	double sample[tex[0]->texelDim];
+	benchFragmentNums[binThread()][0] += 1;
+	texSample(tex[0], vary[VARYS], vary[VARYT], sample);
+	rgbd[0] = sample[TEXR] * unif[UNIFR];
+	rgbd[1] = sample[TEXG] * unif[UNIFG];
+	rgbd[2] = sample[TEXB] * unif[UNIFB];
+	rgbd[3] = vary[VARYZ];
+}
+
+/* The same fragment shader, working on count fragments at once, with the
+varyings and the output laid out as in 260shading.c. The depths are copied in
+one go. */
+void shadeFragmentsBox(
+        int unifDim, const double unif[], int texNum, const texTexture *tex[],
+        int varyDim, int count, const double varys[], double rgbds[]) {
+	const double *s = &varys[VARYS * count], *t = &varys[VARYT * count];
+	double sample[tex[0]->texelDim];
+	int k;
+	benchFragmentNums[binThread()][0] += count;
+	for (k = 0; k < count; k += 1) {
+		texSample(tex[0], s[k], t[k], sample);
+		rgbds[k] = sample[TEXR] * unif[UNIFR];
+		rgbds[count + k] = sample[TEXG] * unif[UNIFG];
+		rgbds[2 * count + k] = sample[TEXB] * unif[UNIFB];
+	}
+	memcpy(&rgbds[3 * count], &varys[VARYZ * count], count * sizeof(double));
+}
+
+/* The landscape shaders, from 340mainLandscape.c. */
+void shadeVertexLand(
+        int unifDim, const double unif[], int attrDim, const double attr[],
+        int varyDim, double vary[]) {
+	double attrHomog[4] = {attr[ATTRX], attr[ATTRY], attr[ATTRZ], 1.0};
+	double modHomog[4];
+	benchVertexNum += 1;
+	mat441Multiply((double(*)[4])(&unif[UNIFMODELING]), attrHomog, modHomog);
+	mat441Multiply((double(*)[4])(&unif[UNIFPROJINVISOM]), modHomog, vary);
+	vecCopy(5, &attr[ATTRS], &vary[VARYLANDS]);
+	vary[VARYV] = 1.0;
+}
+
+void shadeFragmentLand(
+        int unifDim, const double unif[], int texNum, const texTexture *tex[],
+        int varyDim, const double vary[], double rgbd[4]) {
+	double sample[tex[0]->texelDim], temp[varyDim - 4];
+	benchFragmentNums[binThread()][0] += 1;
+	vecScale(varyDim - 4, 1.0 / vary[VARYV], &vary[VARYV], temp);
+	texSample(tex[0], temp[VARYLANDS - 4], temp[VARYLANDT - 4], sample);
+	sample[0] = sample[1] * 0.2 + 0.8;
+	sample[1] = sample[1] * 0.2 + 0.6;
+	sample[2] = 0.3;
+	double intensity = temp[VARYP - 4] / vecLength(3, &temp[VARYN - 4]);
+	vecScale(3, intensity, sample, rgbd);
+	rgbd[3] = vary[VARYZ];
+}
+
+/* The same fragment shader, working on count fragments at once. Only the
+varyings that are used are divided by the perspective-correcting varying, and
+the constant channel is written in one pass. */
+void shadeFragmentsLand(
+        int unifDim, const double unif[], int texNum, const texTexture *tex[],
+        int varyDim, int count, const double varys[], double rgbds[]) {
+	const double *v = &varys[VARYV * count];
+	const double *s = &varys[VARYLANDS * count], *t = &varys[VARYLANDT * count];
+	const double *n = &varys[VARYN * count], *o = &varys[VARYO * count];
+	const double *p = &varys[VARYP * count];
+	double sample[tex[0]->texelDim];
+	int k;
+	benchFragmentNums[binThread()][0] += count;
+	for (k = 0; k < count; k += 1) {
+		double inv = 1.0 / v[k];
+		texSample(tex[0], s[k] * inv, t[k] * inv, sample);
+		double normal[3] = {n[k] * inv, o[k] * inv, p[k] * inv};
+		double intensity = normal[2] / vecLength(3, normal);
+		rgbds[k] = (sample[1] * 0.2 + 0.8) * intensity;
+		rgbds[count + k] = (sample[1] * 0.2 + 0.6) * intensity;
+		rgbds[2 * count + k] = 0.3 * intensity;
+	}
+	memcpy(&rgbds[3 * count], &varys[VARYZ * count], count * sizeof(double));
+}
+
+
+
+/*** Scenes ***/
+
+/* Each scene is set up once, updated from the frame number and the total
+number of frames before each frame, rendered, and torn down. The render
+function returns the number of triangles submitted. */
+typedef struct benchScene benchScene;
+struct benchScene {
+	const char *name;
+	int (*initialize)(void);
+	void (*update)(int frame, int frameNum);
+	int (*render)(void);
+	void (*finalize)(void);
+};
+
+depthBuffer buf;
+texTexture texture;
+const texTexture *textures[1] = {&texture};
+const texTexture **tex = textures;
+double viewport[4][4];
+camCamera cam;
+shaShading boxSha, landSha;
+meshMesh boxMesh, boxMesh2, landMesh;
+double boxUnif[3 + 16 + 16], boxUnif2[3 + 16 + 16], landUnif[3 + 16 + 16];
+
+/* Puts the camera at the origin, looking down the negative z-axis. */
+void benchCameraAtOrigin(void) {
+	double rotation[3][3] = {{1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}};
+	double translation[3] = {0.0, 0.0, 0.0};
+	isoSetRotation(&cam.isometry, rotation);
+	isoSetTranslation(&cam.isometry, translation);
+}
+
+/* Sets the uniform color, the modeling isometry, and the camera's projection
+and inverse isometry in unif. */
+void benchSetUniforms(
+        double unif[], double r, double g, double b, double angle,
+        const double axis[3], const double translation[3]) {
+	double rotation[3][3], isom[4][4], projInvIsom[4][4];
+	unif[UNIFR] = r;
+	unif[UNIFG] = g;
+	unif[UNIFB] = b;
+	mat33AngleAxisRotation(angle, axis, rotation);
+	mat44Isometry(rotation, translation, isom);
+	vecCopy(16, (double *)isom, &unif[UNIFMODELING]);
+	camGetProjectionInverseIsometry(&cam, projInvIsom);
+	vecCopy(16, (double *)projInvIsom, &unif[UNIFPROJINVISOM]);
+}
+
+/* Clears the window and the depth buffer, except in the second pass of a depth
+pre-pass, which must keep the depths written by the first. */
+void benchClear(double red, double green, double blue, double depth) {
+	if (triPass == triPASSCOLOR)
+		return;
+	triClear(&buf, red, green, blue, depth);
+}
+
+/* The spinning box of 250main3D.c. That program worked in pixel coordinates,
+so here an orthographic camera spans one world unit per pixel. */
+int bench3DInitialize(void) {
+	double proj[6] = {-WINDOWW / 2.0, WINDOWW / 2.0, -WINDOWH / 2.0,
+		WINDOWH / 2.0, -1000.0, -1.0};
+	camSetProjectionType(&cam, camORTHOGRAPHIC);
+	camSetProjection(&cam, proj);
+	benchCameraAtOrigin();
+	return mesh3DInitializeBox(&boxMesh, -128.0, 128.0, -64.0, 64.0, -32.0,
+		32.0);
+}
+
+void bench3DUpdate(int frame, int frameNum) {
+	(void)frameNum;
+	double time = frame / 60.0;
+	double axis[3] = {1.0 / sqrt(3.0), 1.0 / sqrt(3.0), 1.0 / sqrt(3.0)};
+	double translation[3] = {0.0, 0.0, -500.0};
+	benchSetUniforms(boxUnif, fabs(sin(time)), fabs(cos(time)), 1.0, time,
+		axis, translation);
+}
+
+int bench3DRender(void) {
+	benchClear(0.0, 0.0, 0.0, 1000000000.0);
+	meshRender(&boxMesh, &buf, viewport, &boxSha, boxUnif, tex);
+	return boxMesh.triNum;
+}
+
+void bench3DFinalize(void) {
+	meshFinalize(&boxMesh);
+}
+
+/* The two boxes of 290mainWorld.c, turning in front of an orthographic
+camera. */
+int benchWorldInitialize(void) {
+	camSetProjectionType(&cam, camORTHOGRAPHIC);
+	camSetFrustum(&cam, M_PI / 6.0, 10.0, 10.0, WINDOWW, WINDOWH);
+	benchCameraAtOrigin();
+	if (mesh3DInitializeBox(&boxMesh, 0.0, 7.0, 0.0, 2.1, 0.0, 5.0) != 0)
+		return 1;
+	if (mesh3DInitializeBox(&boxMesh2, 0.0, 1.6, 0.0, 0.7, 0.0, 4.0) != 0) {
+		meshFinalize(&boxMesh);
+		return 2;
+	}
+	return 0;
+}
+
+void benchWorldUpdate(int frame, int frameNum) {
+	double angle = 0.25 + 2.0 * M_PI * frame / frameNum;
+	double axis[3] = {1.0 / sqrt(3.0), 1.0 / sqrt(3.0), 1.0 / sqrt(3.0)};
+	double translation[3] = {-5.0, -2.75, -35.0};
+	double translation2[3] = {-1.0, -0.2, -35.0};
+	benchSetUniforms(boxUnif, 1.0, 1.0, 1.0, angle, axis, translation);
+	benchSetUniforms(boxUnif2, 1.0, 1.0, 1.0, angle, axis, translation2);
+}
+
+int benchWorldRender(void) {
+	benchClear(0.0, 0.0, 0.0, 10000000000.0);
+	meshRender(&boxMesh, &buf, viewport, &boxSha, boxUnif, tex);
+	meshRender(&boxMesh2, &buf, viewport, &boxSha, boxUnif2, tex);
+	return boxMesh.triNum + boxMesh2.triNum;
+}
+
+void benchWorldFinalize(void) {
+	meshFinalize(&boxMesh2);
+	meshFinalize(&boxMesh);
+}
+
+/* The random landscape of 340mainLandscape.c, generated from LANDSEED rather
+than from the time, with texture coordinates re-assigned as that program
+does. */
+int benchLandInitialize(void) {
+	double landData[LANDSIZE * LANDSIZE];
+	int i;
+	srand(LANDSEED);
+	landFlat(LANDSIZE, landData, 0.0);
+	for (i = 0; i < 12; i += 1)
+		landFaultRandomly(LANDSIZE, landData, 1.0 - i * 0.04);
+	for (i = 0; i < 4; i += 1)
+		landBlur(LANDSIZE, landData);
+	for (i = 0; i < 4; i += 1)
+		landBump(LANDSIZE, landData, landInt(0, LANDSIZE - 1),
+			landInt(0, LANDSIZE - 1), 5.0, 1.0);
+	if (mesh3DInitializeLandscape(&landMesh, LANDSIZE, 1.0, landData) != 0)
+		return 1;
+	for (i = 0; i < landMesh.vertNum; i += 1) {
+		double *vertPtr = meshGetVertexPointer(&landMesh, i);
+		double attr[landMesh.attrDim];
+		vecCopy(landMesh.attrDim, vertPtr, attr);
+		attr[ATTRS] = 0.0;
+		attr[ATTRT] = attr[ATTRZ];
+		meshSetVertex(&landMesh, i, attr);
+	}
+	camSetProjectionType(&cam, camPERSPECTIVE);
+	camSetFrustum(&cam, M_PI / 6.0, 10.0, 10.0, WINDOWW, WINDOWH);
+	return 0;
+}
+
+/* The camera circles the landscape, looking down on it from outside. */
+void benchLandUpdate(int frame, int frameNum) {
+	double target[3] = {LANDSIZE / 2.0, LANDSIZE / 2.0, 0.0};
+	double axis[3] = {0.0, 0.0, 1.0}, translation[3] = {0.0, 0.0, 0.0};
+	camLookAt(&cam, target, 60.0, M_PI * 0.3,
+		M_PI * 0.25 + 2.0 * M_PI * frame / frameNum);
+	benchSetUniforms(landUnif, 1.0, 1.0, 1.0, 0.0, axis, translation);
+}
+
+/* The camera flies low in a circle over the landscape, as one might in
+350mainClipping.c, so that many triangles cross the near plane. */
+void benchClipUpdate(int frame, int frameNum) {
+	double theta = 2.0 * M_PI * frame / frameNum;
+	double position[3] = {LANDSIZE / 2.0 + 12.0 * cos(theta),
+		LANDSIZE / 2.0 + 12.0 * sin(theta), 2.5};
+	double axis[3] = {0.0, 0.0, 1.0}, translation[3] = {0.0, 0.0, 0.0};
+	camLookFrom(&cam, position, M_PI * 0.6, theta + M_PI * 0.75);
+	benchSetUniforms(landUnif, 1.0, 1.0, 1.0, 0.0, axis, translation);
+}
+
+int benchLandRender(void) {
+	benchClear(0.8, 0.8, 1.0, 1000000000.0);
+	meshRender(&landMesh, &buf, viewport, &landSha, landUnif, tex);
+	return landMesh.triNum;
+}
+
+void benchLandFinalize(void) {
+	meshFinalize(&landMesh);
+}
+
+#define SCENENUM 4
+const benchScene benchScenes[SCENENUM] = {
+	{"3d", bench3DInitialize, bench3DUpdate, bench3DRender, bench3DFinalize},
+	{"world", benchWorldInitialize, benchWorldUpdate, benchWorldRender,
+		benchWorldFinalize},
+	{"landscape", benchLandInitialize, benchLandUpdate, benchLandRender,
+		benchLandFinalize},
+	{"clipping", benchLandInitialize, benchClipUpdate, benchLandRender,
+		benchLandFinalize}};
+
+
+
+/*** Measuring ***/
+
+/* Returns the time in seconds on a clock that only moves forward. */
+double benchTime(void) {
+	struct timespec spec;
+	clock_gettime(CLOCK_MONOTONIC, &spec);
+	return spec.tv_sec + spec.tv_nsec * 0.000000001;
+}
+
+int benchCompare(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+/* Returns the pth percentile of the n sorted values, by the nearest-rank
+method. */
+double benchPercentile(int n, const double sorted[], double p) {
+	int rank = (int)ceil(p / 100.0 * n);
+	return sorted[(rank < 1) ? 0 : rank - 1];
+}
+
+const benchScene *benchCurrent;
+const char *benchRasterizer, *benchShading, *benchDepthTest, *benchAntialiasing;
+int benchPrepass, benchDeferred, benchMultisample, benchResolveOnPresent;
+visBuffer benchVis;
+msBuffer benchMS;
+/* The kind of count that the heat map shows, or -1 for no heat map, and the
+totals over the timed frames of each kind. */
+int benchHeatKind;
+const char *benchHeatNames[heatKINDNUM + 1] = {
+	"shaded", "rejected", "written", "none"};
+heatBuffer benchHeat;
+long benchHeatTotals[heatKINDNUM];
+/* The histogram of heat counts reaches red, and its last bin, at this. */
+#define HEATMAX 8
+/* The names of the depth formats of 260depth.c, indexed by format. */
+const char *benchDepthFormatNames[4] = {
+	"double", "float", "unorm24", "unorm32"};
+int benchDepthFormat, benchHiZ, benchDepthLayout;
+int benchFrame, benchFrameNum;
+long benchTriangleNum;
+double *benchMillis;
+/* Totals over the timed frames of the counters and timers in 380stats.c. */
+long benchCounts[statCOUNTNUM];
+unsigned long long benchTicks[statSTAGENUM];
+
+/* Renders one frame of the current scene, timing the warm-up frames too but
+recording only the timed ones. */
+void handleTimeStep(double oldTime, double newTime) {
+	(void)oldTime;
+	(void)newTime;
+	int frame = benchFrame - WARMUPNUM;
+	benchCurrent->update((frame < 0) ? 0 : frame, benchFrameNum);
+	if (frame == 0) {
+		benchVertexNum = 0;
+		for (int k = 0; k < binTHREADMAX; k += 1)
+			benchFragmentNums[k][0] = 0;
+		benchTriangleNum = 0;
+		for (int k = 0; k < statCOUNTNUM; k += 1)
+			benchCounts[k] = 0;
+		for (int k = 0; k < statSTAGENUM; k += 1)
+			benchTicks[k] = 0;
+		for (int k = 0; k < heatKINDNUM; k += 1)
+			benchHeatTotals[k] = 0;
+	}
+	if (benchHeatKind >= 0)
+		heatClear(&benchHeat);
+	double start = benchTime();
+	int triNum;
+	if (benchDeferred)
+		defBegin(&benchVis);
+	if (benchPrepass) {
+		triSetPass(triPASSDEPTH);
+		triNum = benchCurrent->render();
+		triSetPass(triPASSCOLOR);
+		benchCurrent->render();
+		triSetPass(triPASSSINGLE);
+	} else
+		triNum = benchCurrent->render();
+	if (benchDeferred)
+		defEnd();
+	if (benchMultisample && !benchResolveOnPresent)
+		msResolve(&benchMS);
+	double millis = (benchTime() - start) * 1000.0;
+	statEndFrame();
+	if (frame >= 0) {
+		benchMillis[frame] = millis;
+		benchTriangleNum += triNum;
+		for (int k = 0; k < statCOUNTNUM; k += 1)
+			benchCounts[k] += statGetCount(k);
+		for (int k = 0; k < statSTAGENUM; k += 1)
+			benchTicks[k] += statGetTicks(k);
+		for (int k = 0; k < heatKINDNUM && benchHeatKind >= 0; k += 1)
+			benchHeatTotals[k] += heatGetTotal(&benchHeat, k);
+	}
+	if (benchHeatKind >= 0 && !benchResolveOnPresent)
+		heatShow(&benchHeat, benchHeatKind, HEATMAX);
+	benchFrame += 1;
+}
+
+/* Resolves the samples of the frame just before it is presented. */
+void handlePresent(void) {
+	msResolve(&benchMS);
+	if (benchHeatKind >= 0)
+		heatShow(&benchHeat, benchHeatKind, HEATMAX);
+}
+
+/* Runs the scene and prints its report. Returns 0 on success. */
+int benchRun(const benchScene *scene, int frameNum, double *rgb) {
+	int i;
+	if (scene->initialize() != 0) {
+		fprintf(stderr, "error: benchRun: %s failed to initialize\n",
+			scene->name);
+		return 1;
+	}
+	benchCurrent = scene;
+	benchFrame = 0;
+	benchFrameNum = frameNum;
+	pixSetTimeStepHandler(handleTimeStep);
+	pixSetFrameCount(WARMUPNUM + frameNum);
+	pixRun();
+	pixCopyRGB(rgb);
+	scene->finalize();
+	double total = 0.0, checksum = 0.0;
+	long fragmentNum = 0;
+	for (i = 0; i < frameNum; i += 1)
+		total += benchMillis[i];
+	for (i = 0; i < binTHREADMAX; i += 1)
+		fragmentNum += benchFragmentNums[i][0];
+	for (i = 0; i < WINDOWW * WINDOWH * 3; i += 1)
+		checksum += rgb[i] * (i % 7 + 1);
+	qsort(benchMillis, frameNum, sizeof(double), benchCompare);
+	printf("{\"scene\": \"%s\", \"rasterizer\": \"%s\", \"threads\": %d, "
+		"\"shading\": \"%s\", \"depthTest\": \"%s\", "
+		"\"antialiasing\": \"%s\", \"heatMap\": \"%s\", "
+		"\"depthFormat\": \"%s\", \"hiZ\": \"%s\", \"depthLayout\": \"%s\", "
+		"\"frames\": %d, \"msMean\": %.4f, "
+		"\"msP50\": %.4f, \"msP99\": %.4f, \"trianglesPerSec\": %.1f, "
+		"\"fragmentsPerSec\": %.1f, \"vertexInvocations\": %ld, "
+		"\"fragmentInvocations\": %ld, \"checksum\": %.6f", scene->name,
+		benchRasterizer, binThreadNum, benchShading, benchDepthTest,
+		benchAntialiasing,
+		benchHeatNames[(benchHeatKind >= 0) ? benchHeatKind : heatKINDNUM],
+		benchDepthFormatNames[benchDepthFormat], benchHiZ ? "on" : "off",
+		(benchDepthLayout == depthTILED) ? "tiled" : "linear", frameNum,
+		total / frameNum, benchPercentile(frameNum, benchMillis, 50.0),
+		benchPercentile(frameNum, benchMillis, 99.0),
+		benchTriangleNum / (total * 0.001), fragmentNum / (total * 0.001),
+		benchVertexNum, fragmentNum, checksum);
+#ifdef STATS
+	/* Per-frame means of the pipeline counters and stage timers. */
+	for (i = 0; i < statCOUNTNUM; i += 1)
+		printf(", \"%s\": %.1f", statCountName(i),
+			(double)benchCounts[i] / frameNum);
+	for (i = 0; i < statSTAGENUM; i += 1)
+		printf(", \"%sTicks\": %.0f", statStageName(i),
+			(double)benchTicks[i] / frameNum);
+#endif
+	if (benchHeatKind >= 0) {
+		/* Per-frame means of the heat totals, and the histogram of the last
+		frame. */
+		long bins[HEATMAX + 1];
+		for (i = 0; i < heatKINDNUM; i += 1)
+			printf(", \"%sPerFrame\": %.1f", benchHeatNames[i],
+				(double)benchHeatTotals[i] / frameNum);
+		heatGetHistogram(&benchHeat, benchHeatKind, HEATMAX + 1, bins);
+		printf(", \"histogram\": [");
+		for (i = 0; i <= HEATMAX; i += 1)
+			printf((i == 0) ? "%ld" : ", %ld", bins[i]);
+		printf("]");
+	}
+	printf("}\n");
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	const char *name = (argc > 1) ? argv[1] : "all";
+	int frameNum = (argc > 2) ? atoi(argv[2]) : 120, i, found = 0, error = 0;
+	if (frameNum < 1) {
+		fprintf(stderr, "error: main: frameNum must be positive\n");
+		return 1;
+	}
+	const char *rasterizerNames[3] = {"columns", "edges", "fixed"};
+	const int modes[3] = {triCOLUMNS, triEDGES, triFIXED};
+	benchRasterizer = (argc > 3) ? argv[3] : "edges";
+	int mode = -1;
+	for (i = 0; i < 3; i += 1)
+		if (strcmp(benchRasterizer, rasterizerNames[i]) == 0)
+			mode = modes[i];
+	if (mode < 0) {
+		fprintf(stderr, "error: main: unknown rasterizer %s\n",
+			benchRasterizer);
+		return 1;
+	}
+	triSetMode(mode);
+	int threadNum = (argc > 4) ? atoi(argv[4]) : 1;
+	if (threadNum < 1 || threadNum > binTHREADMAX) {
+		fprintf(stderr, "error: main: threadNum must be from 1 to %d\n",
+			binTHREADMAX);
+		return 1;
+	}
+	benchShading = (argc > 5) ? argv[5] : "batched";
+	benchDeferred = (strcmp(benchShading, "deferred") == 0);
+	int batched = benchDeferred || (strcmp(benchShading, "batched") == 0);
+	if (!batched && strcmp(benchShading, "pixel") != 0) {
+		fprintf(stderr, "error: main: unknown shading %s\n", benchShading);
+		return 1;
+	}
+	benchDepthTest = (argc > 6) ? argv[6] : "early";
+	benchPrepass = (strcmp(benchDepthTest, "prepass") == 0);
+	int early = benchPrepass || (strcmp(benchDepthTest, "early") == 0);
+	if (!early && strcmp(benchDepthTest, "late") != 0) {
+		fprintf(stderr, "error: main: unknown depthTest %s\n", benchDepthTest);
+		return 1;
+	}
+	if (benchDeferred && (!early || benchPrepass)) {
+		fprintf(stderr, "error: main: deferred shading needs early depthTest\n");
+		return 1;
+	}
+	benchAntialiasing = (argc > 7) ? argv[7] : "none";
+	benchResolveOnPresent = (strcmp(benchAntialiasing, "msaa-present") == 0);
+	benchMultisample = benchResolveOnPresent ||
+		(strcmp(benchAntialiasing, "msaa") == 0);
+	if (!benchMultisample && strcmp(benchAntialiasing, "none") != 0) {
+		fprintf(stderr, "error: main: unknown antialiasing %s\n",
+			benchAntialiasing);
+		return 1;
+	}
+	if (benchMultisample && (benchDeferred || benchPrepass)) {
+		fprintf(stderr, "error: main: msaa needs forward shading\n");
+		return 1;
+	}
+	const char *heatMap = (argc > 8) ? argv[8] : "none";
+	benchHeatKind = -2;
+	for (i = 0; i <= heatKINDNUM; i += 1)
+		if (strcmp(heatMap, benchHeatNames[i]) == 0)
+			benchHeatKind = (i < heatKINDNUM) ? i : -1;
+	if (benchHeatKind == -2) {
+		fprintf(stderr, "error: main: unknown heatMap %s\n", heatMap);
+		return 1;
+	}
+	const char *depthFormat = (argc > 9) ? argv[9] : "double";
+	benchDepthFormat = -1;
+	for (i = 0; i < 4; i += 1)
+		if (strcmp(depthFormat, benchDepthFormatNames[i]) == 0)
+			benchDepthFormat = i;
+	if (benchDepthFormat < 0) {
+		fprintf(stderr, "error: main: unknown depthFormat %s\n", depthFormat);
+		return 1;
+	}
+	const char *hiZ = (argc > 10) ? argv[10] : "on";
+	benchHiZ = (strcmp(hiZ, "on") == 0);
+	if (!benchHiZ && strcmp(hiZ, "off") != 0) {
+		fprintf(stderr, "error: main: unknown hiZ %s\n", hiZ);
+		return 1;
+	}
+	const char *depthLayout = (argc > 11) ? argv[11] : "linear";
+	benchDepthLayout = (strcmp(depthLayout, "tiled") == 0) ? depthTILED :
+		depthLINEAR;
+	if (benchDepthLayout == depthLINEAR && strcmp(depthLayout, "linear") != 0) {
+		fprintf(stderr, "error: main: unknown depthLayout %s\n", depthLayout);
+		return 1;
+	}
+	/* Marshal resources. */
+	if (pixInitialize(WINDOWW, WINDOWH, "Benchmark") != 0)
+		return 2;
+	if (depthInitializeLayout(&buf, WINDOWW, WINDOWH,
+			benchMultisample ? msSAMPLENUM : 1, benchDepthFormat,
+			benchDepthLayout) != 0) {
+		pixFinalize();
+		return 3;
+	}
+	if (texInitializeFile(&texture, "awesome.png") != 0) {
+		depthFinalize(&buf);
+		pixFinalize();
+		return 4;
+	}
+	if (visInitialize(&benchVis, WINDOWW, WINDOWH) != 0) {
+		texFinalize(&texture);
+		depthFinalize(&buf);
+		pixFinalize();
+		return 4;
+	}
+	if (msInitialize(&benchMS, WINDOWW, WINDOWH) != 0) {
+		visFinalize(&benchVis);
+		texFinalize(&texture);
+		depthFinalize(&buf);
+		pixFinalize();
+		return 4;
+	}
+	if (heatInitialize(&benchHeat, WINDOWW, WINDOWH) != 0) {
+		msFinalize(&benchMS);
+		visFinalize(&benchVis);
+		texFinalize(&texture);
+		depthFinalize(&buf);
+		pixFinalize();
+		return 4;
+	}
+	double *rgb = (double *)malloc(WINDOWW * WINDOWH * 3 * sizeof(double));
+	benchMillis = (double *)malloc(frameNum * sizeof(double));
+	if (rgb == NULL || benchMillis == NULL) {
+		free(rgb);
+		free(benchMillis);
+		heatFinalize(&benchHeat);
+		msFinalize(&benchMS);
+		visFinalize(&benchVis);
+		texFinalize(&texture);
+		depthFinalize(&buf);
+		pixFinalize();
+		return 5;
+	}
+	texSetFiltering(&texture, texNEAREST);
+	texSetLeftRight(&texture, texREPEAT);
+	texSetTopBottom(&texture, texREPEAT);
+	/* Configure shader programs and viewport. */
+	boxSha.unifDim = 3 + 16 + 16;
+	boxSha.attrDim = 3 + 2 + 3;
+	boxSha.varyDim = 4 + 2;
+	boxSha.shadeVertex = shadeVertexBox;
+	boxSha.shadeFragment = shadeFragmentBox;
+	boxSha.shadeFragments = batched ? shadeFragmentsBox : NULL;
+	boxSha.depthVary = early ? VARYZ : 0;
+	boxSha.texNum = 1;
+	landSha.unifDim = 3 + 16 + 16;
+	landSha.attrDim = 3 + 2 + 3;
+	landSha.varyDim = 5 + 2 + 3;
+	landSha.shadeVertex = shadeVertexLand;
+	landSha.shadeFragment = shadeFragmentLand;
+	landSha.shadeFragments = batched ? shadeFragmentsLand : NULL;
+	landSha.depthVary = early ? VARYZ : 0;
+	landSha.texNum = 1;
+	mat44Viewport(WINDOWW, WINDOWH, viewport);
+	binSetThreadNum(threadNum);
+	triSetHierarchicalZ(benchHiZ);
+	if (benchHeatKind >= 0)
+		triSetHeatMap(&benchHeat);
+	if (benchMultisample) {
+		triSetMultisample(&benchMS);
+		msSetRowWriter(pixSetRGBSpan);
+	}
+	if (benchResolveOnPresent)
+		pixSetPresentHandler(handlePresent);
+#ifdef TRACE
+	pixSetTraceHandlers(traceBegin, traceEnd);
+#endif
+	/* Run the chosen scenes. */
+	for (i = 0; i < SCENENUM; i += 1)
+		if (strcmp(name, "all") == 0 || strcmp(name, benchScenes[i].name) == 0) {
+			found = 1;
+			if (benchRun(&benchScenes[i], frameNum, rgb) != 0)
+				error = 1;
+		}
+	if (!found)
+		fprintf(stderr, "error: main: unknown scene %s\n", name);
+#ifdef TRACE
+	if (traceExport("benchmark.json") != 0)
+		error = 1;
+#endif
+	/* Clean up. */
+	defFinalize();
+	binFinalize();
+	free(benchMillis);
+	free(rgb);
+	heatFinalize(&benchHeat);
+	msFinalize(&benchMS);
+	visFinalize(&benchVis);
+	texFinalize(&texture);
+	depthFinalize(&buf);
+	pixFinalize();
+	return (!found || error) ? 6 : 0;
+}
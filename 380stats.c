@@ -0,0 +1,185 @@
+
+
+
+/* This file is an optional instrumentation layer for the rendering pipeline.
+It counts the triangles and fragments passing through each stage, and it
+measures the time spent in each stage. It is compiled in only when STATS is
+defined, for example by compiling with -DSTATS. Otherwise statCount, statBegin,
+and statEnd expand to nothing, and the reading functions return zero, so the
+pipeline pays nothing for the instrumentation.
+
+The pipeline calls statCount, statBegin, and statEnd as it works. The program
+calls statEndFrame after each frame, and then reads that frame's numbers with
+statGetCount and statGetTicks.
+
+Each thread counts and times its own work. A helper thread, such as a worker of
+400bin.c, hands its numbers to the frame by calling statMergeThread when it
+finishes a batch of work. So with several threads, the times add up to the
+total over all threads, which may exceed the elapsed time. */
+
+/* The counters. */
+#define statSUBMITTED 0		/* triangles submitted to meshRender */
+#define statCLIPPED 1		/* triangles cut or discarded by the near plane */
+#define statCULLED 2		/* triangles back-face culled */
+#define statRASTERIZED 3	/* triangles rasterized, after clipping splits */
+#define statSHADED 4		/* fragments shaded */
+#define statDEPTHFAILED 5	/* fragments failing the depth test */
+#define statWRITTEN 6		/* fragments written */
+#define statHIZCULLED 7		/* triangles rejected whole by hierarchical Z */
+#define statHIZTILES 8		/* depth tiles of triangles rejected likewise */
+#define statCOUNTNUM 9
+
+/* The stages timed. Time spent in a stage that begins inside another stage is
+charged only to the inner stage, so the times add up to the total. */
+#define statVERTEX 0		/* vertex shading in meshRender */
+#define statCLIP 1			/* clipping in meshClipping */
+#define statSETUP 2			/* triangle setup and traversal in triRender */
+#define statFRAGMENT 3		/* interpolation and fragment shading */
+#define statDEPTH 4			/* depth test and writes */
+#define statSTAGENUM 5
+
+#ifdef STATS
+
+#include <stdio.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+/* Returns a reading of the cheapest available clock. On x86 it is the
+processor's time stamp counter, which counts cycles at a fixed rate. */
+static inline unsigned long long statTicks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return (unsigned long long)clock();
+#endif
+}
+
+#define statSTACKSIZE 16
+
+/* The running numbers of each thread. */
+__thread long statCounts[statCOUNTNUM];
+__thread unsigned long long statStageTicks[statSTAGENUM];
+__thread int statStack[statSTACKSIZE], statDepth = 0;
+__thread unsigned long long statStart;
+
+/* The numbers merged from other threads, and those of the last frame. */
+pthread_mutex_t statMutex = PTHREAD_MUTEX_INITIALIZER;
+long statMergedCounts[statCOUNTNUM], statFrameCounts[statCOUNTNUM];
+unsigned long long statMergedTicks[statSTAGENUM], statFrameTicks[statSTAGENUM];
+
+#define statCount(counter, n) (statCounts[counter] += (n))
+
+/* Charges the time since the last transition to the current stage, and then
+enters the given stage. */
+static inline void statBegin(int stage) {
+	unsigned long long now = statTicks();
+	if (statDepth > 0)
+		statStageTicks[statStack[statDepth - 1]] += now - statStart;
+	if (statDepth < statSTACKSIZE)
+		statStack[statDepth] = stage;
+	statDepth += 1;
+	statStart = now;
+}
+
+/* Charges the time since the last transition to the current stage, and then
+returns to the enclosing stage. The given stage must be the current one, so
+that unbalanced calls are reported rather than silently misattributed. */
+static inline void statEnd(int stage) {
+	unsigned long long now = statTicks();
+	if (statDepth > 0 && statDepth <= statSTACKSIZE) {
+		if (statStack[statDepth - 1] != stage)
+			fprintf(stderr, "error: statEnd: ending stage %d inside stage %d\n",
+				stage, statStack[statDepth - 1]);
+		statStageTicks[statStack[statDepth - 1]] += now - statStart;
+	}
+	statDepth -= 1;
+	statStart = now;
+}
+
+/* Adds the calling thread's numbers to those of the current frame, and starts
+the thread's numbers from zero. */
+void statMergeThread(void) {
+	int k;
+	pthread_mutex_lock(&statMutex);
+	for (k = 0; k < statCOUNTNUM; k += 1) {
+		statMergedCounts[k] += statCounts[k];
+		statCounts[k] = 0;
+	}
+	for (k = 0; k < statSTAGENUM; k += 1) {
+		statMergedTicks[k] += statStageTicks[k];
+		statStageTicks[k] = 0;
+	}
+	pthread_mutex_unlock(&statMutex);
+}
+
+/* Ends the current frame. Its numbers, including those merged from other
+threads, become readable, and the next frame starts from zero. */
+void statEndFrame(void) {
+	int k;
+	statMergeThread();
+	pthread_mutex_lock(&statMutex);
+	for (k = 0; k < statCOUNTNUM; k += 1) {
+		statFrameCounts[k] = statMergedCounts[k];
+		statMergedCounts[k] = 0;
+	}
+	for (k = 0; k < statSTAGENUM; k += 1) {
+		statFrameTicks[k] = statMergedTicks[k];
+		statMergedTicks[k] = 0;
+	}
+	pthread_mutex_unlock(&statMutex);
+}
+
+/* Returns the given counter, as of the last call to statEndFrame. */
+long statGetCount(int counter) {
+	return statFrameCounts[counter];
+}
+
+/* Returns the ticks spent in the given stage during the last frame. */
+unsigned long long statGetTicks(int stage) {
+	return statFrameTicks[stage];
+}
+
+#else
+
+#define statCount(counter, n) ((void)0)
+#define statBegin(stage) ((void)0)
+#define statEnd(stage) ((void)0)
+
+void statMergeThread(void) {
+}
+
+void statEndFrame(void) {
+}
+
+long statGetCount(int counter) {
+	(void)counter;
+	return 0;
+}
+
+unsigned long long statGetTicks(int stage) {
+	(void)stage;
+	return 0;
+}
+
+#endif
+
+/* Returns a short name for the given counter, for reports. */
+const char *statCountName(int counter) {
+	const char *names[statCOUNTNUM] = {"submitted", "clipped", "culled",
+		"rasterized", "shaded", "depthFailed", "written", "hizCulled",
+		"hizTiles"};
+	return names[counter];
+}
+
+/* Returns a short name for the given stage, for reports. */
+const char *statStageName(int stage) {
+	const char *names[statSTAGENUM] = {"vertex", "clip", "setup", "fragment",
+		"depth"};
+	return names[stage];
+}
+
+
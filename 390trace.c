@@ -0,0 +1,176 @@
+
+
+
+/* This file records a timeline of the work done by the rendering pipeline, so
+that it can be inspected in a trace viewer such as chrome://tracing or
+Perfetto. Like 380stats.c, it is compiled in only when TRACE is defined, for
+example by compiling with -DTRACE. Otherwise traceBegin and traceEnd expand to
+nothing. Tracing needs the POSIX clock_gettime and threads.
+
+Code marks a span of work by calling traceBegin with a name and then traceEnd.
+Spans nest. Each thread writes its finished spans into its own ring buffer of
+traceCAPACITY events, so that threads never contend, and so that a
+long-running program keeps only its most recent history. A ring is allocated
+when its thread begins its first span, and kept for the life of the program,
+so that the spans of finished threads can still be exported. traceExport
+writes every ring as a Chrome trace-event JSON file, with one track per thread.
+traceClear and traceExport must be called while no other thread is tracing, for
+example between frames. The names must be string literals (or otherwise
+outlive the trace), because only the pointers are recorded. */
+
+#define traceCAPACITY 65536
+#define traceSTACKSIZE 32
+
+#ifdef TRACE
+
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+typedef struct traceEvent traceEvent;
+struct traceEvent {
+	const char *name;
+	double start, duration;		/* in microseconds */
+};
+
+/* The events of one thread. */
+typedef struct traceRing traceRing;
+struct traceRing {
+	traceEvent events[traceCAPACITY];
+	long eventNum;				/* events ever written, including lost ones */
+	const char *openNames[traceSTACKSIZE];
+	double openStarts[traceSTACKSIZE];
+	int depth;
+	int tid;					/* 1 for the first thread to trace, and so on */
+	traceRing *next;
+};
+
+pthread_mutex_t traceMutex = PTHREAD_MUTEX_INITIALIZER;
+traceRing *traceRings = NULL;	/* every thread's ring, newest first */
+int traceRingNum = 0;
+__thread traceRing *traceOwnRing = NULL;
+double traceOrigin = -1.0;
+
+/* Returns microseconds on the monotonic clock. */
+double traceClock(void) {
+	struct timespec spec;
+	clock_gettime(CLOCK_MONOTONIC, &spec);
+	return spec.tv_sec * 1000000.0 + spec.tv_nsec * 0.001;
+}
+
+/* Returns the calling thread's ring, allocating and registering it on first
+use. Returns NULL if memory runs out, in which case the thread is not traced. */
+traceRing *traceGetRing(void) {
+	if (traceOwnRing == NULL) {
+		traceOwnRing = (traceRing *)calloc(1, sizeof(traceRing));
+		if (traceOwnRing == NULL)
+			return NULL;
+		pthread_mutex_lock(&traceMutex);
+		/* The origin is set once, before any ring can record a time. */
+		if (traceOrigin < 0.0)
+			traceOrigin = traceClock();
+		traceRingNum += 1;
+		traceOwnRing->tid = traceRingNum;
+		traceOwnRing->next = traceRings;
+		traceRings = traceOwnRing;
+		pthread_mutex_unlock(&traceMutex);
+	}
+	return traceOwnRing;
+}
+
+/* Returns microseconds since the first thread began tracing. */
+double traceTime(void) {
+	return traceClock() - traceOrigin;
+}
+
+/* Begins a span with the given name, nested inside any spans already open on
+the calling thread. */
+void traceBegin(const char *name) {
+	traceRing *ring = traceGetRing();
+	if (ring == NULL)
+		return;
+	if (ring->depth < traceSTACKSIZE) {
+		ring->openNames[ring->depth] = name;
+		ring->openStarts[ring->depth] = traceTime();
+	}
+	ring->depth += 1;
+}
+
+/* Ends the calling thread's innermost open span and records it, overwriting
+the thread's oldest event if its ring is full. */
+void traceEnd(void) {
+	traceRing *ring = traceOwnRing;
+	if (ring == NULL || ring->depth <= 0)
+		return;
+	ring->depth -= 1;
+	if (ring->depth < traceSTACKSIZE) {
+		traceEvent *event = &ring->events[ring->eventNum % traceCAPACITY];
+		event->name = ring->openNames[ring->depth];
+		event->start = ring->openStarts[ring->depth];
+		event->duration = traceTime() - event->start;
+		ring->eventNum += 1;
+	}
+}
+
+/* Forgets all recorded events of every thread. Spans that are open stay
+open. */
+void traceClear(void) {
+	traceRing *ring;
+	pthread_mutex_lock(&traceMutex);
+	for (ring = traceRings; ring != NULL; ring = ring->next)
+		ring->eventNum = 0;
+	pthread_mutex_unlock(&traceMutex);
+}
+
+/* Writes the recorded events to the given path as Chrome trace-event JSON,
+each thread's oldest first, with the thread's number as its tid. Returns 0 on
+success. */
+int traceExport(const char *path) {
+	FILE *file = fopen(path, "w");
+	if (file == NULL) {
+		fprintf(stderr, "error: traceExport: fopen failed\n");
+		return 1;
+	}
+	const traceRing *ring;
+	long first, i;
+	int written = 0;
+	fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+	pthread_mutex_lock(&traceMutex);
+	for (ring = traceRings; ring != NULL; ring = ring->next) {
+		first = (ring->eventNum > traceCAPACITY) ?
+			ring->eventNum - traceCAPACITY : 0;
+		for (i = first; i < ring->eventNum; i += 1) {
+			const traceEvent *event = &ring->events[i % traceCAPACITY];
+			fprintf(file, "%s\n{\"name\": \"%s\", \"ph\": \"X\", "
+				"\"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %d}",
+				written ? "," : "", event->name, event->start,
+				event->duration, ring->tid);
+			written = 1;
+		}
+	}
+	pthread_mutex_unlock(&traceMutex);
+	fprintf(file, "\n]}\n");
+	if (fclose(file) != 0) {
+		fprintf(stderr, "error: traceExport: write failed\n");
+		return 2;
+	}
+	return 0;
+}
+
+#else
+
+#define traceBegin(name) ((void)0)
+#define traceEnd() ((void)0)
+
+void traceClear(void) {
+}
+
+int traceExport(const char *path) {
+	(void)path;
+	fprintf(stderr, "error: traceExport: compiled without TRACE\n");
+	return 1;
+}
+
+#endif
+
+
@@ -0,0 +1,324 @@
+
+
+
+/* This file divides the rasterization of a mesh among threads, in the manner
+of a sort-middle pipeline. meshRender shades the vertices and clips the
+triangles on the calling thread as usual. But instead of rasterizing each
+triangle at once, it hands the triangle to binTriangle, which stores it and
+notes which binTILESIZE x binTILESIZE tiles of the screen its bounding box
+touches. Then binFlush rasterizes the tiles on a pool of threads. Each tile is
+drawn by one thread, which owns the tile's pixels and depths, so the threads
+need no locks while they draw. Within a tile, the triangles are drawn in the
+order in which they were submitted, and 270triangle.c gives a pixel the same
+color however the triangle is divided, so the image is identical to that of
+the single-threaded path, regardless of the number of threads.
+
+binTILESIZE is a multiple of pixTILESIZE, depthTILESIZE, and triBLOCKSIZE, so
+that the lazy clears and the dirty tracking of 040pixelHeadless.c and
+260depth.c never touch the same memory from two threads. The fragment shader
+runs on all of the threads, so it must not write to shared variables without
+care. binThread tells a shader which thread is running it. 390trace.c is not
+thread-safe, so the threads record no spans of their own.
+
+The pool can also run other work that divides into independent jobs, through
+binRun. */
+
+#include <string.h>
+#include <pthread.h>
+
+#define binTILESIZE 64
+#define binTHREADMAX 64
+
+/* The pool. The calling thread counts as one of the binThreadNum threads. */
+int binThreadNum = 1;
+pthread_t binThreads[binTHREADMAX];
+pthread_mutex_t binMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t binStartCond = PTHREAD_COND_INITIALIZER;
+pthread_cond_t binDoneCond = PTHREAD_COND_INITIALIZER;
+int binGeneration = 0, binBusyNum = 0, binQuitting = 0;
+__thread int binThreadIndex = 0;
+
+/* The triangles of the current batch, after the viewport transformation. Each
+has 3 * binVaryDim varyings, the range of tiles {colMin, rowMin, colMax,
+rowMax} that it touches, and the ID set by triSetID when it was binned. */
+double *binVarys = NULL;
+int *binRanges = NULL, *binIDs = NULL;
+int binTriNum = 0, binVaryCap = 0, binRangeCap = 0, binIDCap = 0;
+int binVaryDim = 0;
+
+/* The triangles of tile t are binTris[binStarts[t]] through
+binTris[binStarts[t + 1] - 1], in order of submission. */
+int *binStarts = NULL, *binTris = NULL;
+int binTileCap = 0, binRefCap = 0;
+
+/* The work that the threads are doing: jobs 0 through binJobNum - 1, handed
+out in order. */
+void (*binJob)(int);
+int binJobNum, binNextJob;
+
+/* The batch that binRenderTile draws, and the part of the buffer that it may
+draw, as found by triGetClip. */
+const shaShading *binSha;
+depthBuffer *binBuf;
+const double *binUnif;
+const texTexture **binTex;
+int binTileColNum, binTileRowNum;
+int binClip[4];
+
+/* Returns the index of the calling thread, from 0 for the thread that calls
+binFlush to binThreadNum - 1. */
+int binThread(void) {
+	return binThreadIndex;
+}
+
+/* Draws the triangles of the given tile. A triangle is counted in the
+statistics by the thread that draws its first tile. */
+void binRenderTile(int tile) {
+	int col = tile % binTileColNum, row = tile / binTileColNum, t, n;
+	int clip[4] = {col * binTILESIZE, row * binTILESIZE,
+		(col + 1) * binTILESIZE - 1, (row + 1) * binTILESIZE - 1};
+	clip[0] = (clip[0] < binClip[0]) ? binClip[0] : clip[0];
+	clip[1] = (clip[1] < binClip[1]) ? binClip[1] : clip[1];
+	clip[2] = (clip[2] > binClip[2]) ? binClip[2] : clip[2];
+	clip[3] = (clip[3] > binClip[3]) ? binClip[3] : clip[3];
+	for (n = binStarts[tile]; n < binStarts[tile + 1]; n += 1) {
+		t = binTris[n];
+		const double *a = &binVarys[t * 3 * binVaryDim];
+		statBegin(statSETUP);
+		triSetID(binIDs[t]);
+		/* The triangle counts once, in the first of its tiles. */
+		if (triRenderClipped(binSha, binBuf, binUnif, binTex, a,
+				a + binVaryDim, a + 2 * binVaryDim, clip)) {
+			if (col == binRanges[t * 4] && row == binRanges[t * 4 + 1])
+				statCount(statCULLED, 1);
+		} else if (col == binRanges[t * 4] && row == binRanges[t * 4 + 1])
+			statCount(statRASTERIZED, 1);
+		statEnd(statSETUP);
+	}
+}
+
+/* Does jobs until there are none left. */
+void binWork(void) {
+	int job = __atomic_fetch_add(&binNextJob, 1, __ATOMIC_RELAXED);
+	while (job < binJobNum) {
+		binJob(job);
+		job = __atomic_fetch_add(&binNextJob, 1, __ATOMIC_RELAXED);
+	}
+}
+
+/* The body of each helper thread. */
+void *binWorker(void *index) {
+	int generation = 0;
+	binThreadIndex = (int)(long)index;
+	pthread_mutex_lock(&binMutex);
+	while (1) {
+		while (binGeneration == generation && !binQuitting)
+			pthread_cond_wait(&binStartCond, &binMutex);
+		if (binQuitting)
+			break;
+		generation = binGeneration;
+		pthread_mutex_unlock(&binMutex);
+		binWork();
+		statMergeThread();
+		pthread_mutex_lock(&binMutex);
+		binBusyNum -= 1;
+		if (binBusyNum == 0)
+			pthread_cond_signal(&binDoneCond);
+	}
+	pthread_mutex_unlock(&binMutex);
+	return NULL;
+}
+
+/* Sets the number of threads that rasterize meshes, counting the calling
+thread, from 1 to binTHREADMAX. With one thread, which is the default, meshes
+are rasterized directly, without binning. Returns the number of threads
+actually in use, which is less than requested if threads cannot be started. */
+int binSetThreadNum(int threadNum) {
+	int i;
+	if (threadNum < 1)
+		threadNum = 1;
+	if (threadNum > binTHREADMAX)
+		threadNum = binTHREADMAX;
+	/* Stop the old helpers, if any. */
+	pthread_mutex_lock(&binMutex);
+	binQuitting = 1;
+	pthread_cond_broadcast(&binStartCond);
+	pthread_mutex_unlock(&binMutex);
+	for (i = 1; i < binThreadNum; i += 1)
+		pthread_join(binThreads[i], NULL);
+	binQuitting = 0;
+	binGeneration = 0;
+	/* Start the new ones. */
+	for (i = 1; i < threadNum; i += 1)
+		if (pthread_create(&binThreads[i], NULL, binWorker, (void *)(long)i)
+				!= 0) {
+			fprintf(stderr, "error: binSetThreadNum: pthread_create failed\n");
+			break;
+		}
+	binThreadNum = i;
+	return binThreadNum;
+}
+
+/* Runs job(0) through job(jobNum - 1) on all of the threads, in no particular 
+order, and waits for them to finish. The jobs must not depend on each other. */
+void binRun(void (*job)(int), int jobNum) {
+	binJob = job;
+	binJobNum = jobNum;
+	binNextJob = 0;
+	pthread_mutex_lock(&binMutex);
+	binGeneration += 1;
+	binBusyNum = binThreadNum - 1;
+	pthread_cond_broadcast(&binStartCond);
+	pthread_mutex_unlock(&binMutex);
+	binWork();
+	pthread_mutex_lock(&binMutex);
+	while (binBusyNum > 0)
+		pthread_cond_wait(&binDoneCond, &binMutex);
+	pthread_mutex_unlock(&binMutex);
+}
+
+/* Stops the helper threads and deallocates the bins. */
+void binFinalize(void) {
+	binSetThreadNum(1);
+	free(binVarys);
+	free(binRanges);
+	free(binIDs);
+	free(binStarts);
+	free(binTris);
+	binVarys = NULL;
+	binRanges = NULL;
+	binIDs = NULL;
+	binStarts = NULL;
+	binTris = NULL;
+	binVaryCap = 0;
+	binRangeCap = 0;
+	binIDCap = 0;
+	binTileCap = 0;
+	binRefCap = 0;
+}
+
+/* Grows the array at *array, of *cap elements of the given size, to hold at
+least num elements. Returns 0 on success. */
+int binReserve(void **array, int *cap, int num, size_t size) {
+	if (num <= *cap)
+		return 0;
+	int newCap = (*cap < 1024) ? 1024 : *cap;
+	while (newCap < num)
+		newCap *= 2;
+	void *newArray = realloc(*array, newCap * size);
+	if (newArray == NULL) {
+		fprintf(stderr, "error: binReserve: realloc failed\n");
+		return 1;
+	}
+	*array = newArray;
+	*cap = newCap;
+	return 0;
+}
+
+/* Stores the triangle abc, whose varyings have been through the viewport
+transformation, to be rasterized by binFlush. All of the triangles of a batch
+must have the same shading. */
+void binTriangle(
+		const shaShading *sha, depthBuffer *buf, const double unif[],
+		const texTexture *tex[], const double a[], const double b[],
+		const double c[]) {
+	int varyDim = sha->varyDim, clip[4];
+	triGetClip(buf->width, buf->height, clip);
+	/* The bounding box is rounded outward, so that it contains every pixel
+	that any rasterizer might cover. */
+	double xLow = floor(fmin(a[0], fmin(b[0], c[0]))) - 1.0;
+	double xHigh = ceil(fmax(a[0], fmax(b[0], c[0]))) + 1.0;
+	double yLow = floor(fmin(a[1], fmin(b[1], c[1]))) - 1.0;
+	double yHigh = ceil(fmax(a[1], fmax(b[1], c[1]))) + 1.0;
+	if (!(xHigh >= clip[0] && yHigh >= clip[1] && xLow <= clip[2] &&
+			yLow <= clip[3])) {
+		/* The triangle is off the screen or outside the scissor, and there is
+		nothing to draw. But it still counts as culled or rasterized, as it
+		would when drawn directly. */
+		if (triRenderClipped(sha, buf, unif, tex, a, b, c, clip))
+			statCount(statCULLED, 1);
+		else
+			statCount(statRASTERIZED, 1);
+		return;
+	}
+	if (binReserve((void **)&binVarys, &binVaryCap,
+			(binTriNum + 1) * 3 * varyDim, sizeof(double)) != 0)
+		return;
+	if (binReserve((void **)&binRanges, &binRangeCap, binTriNum + 1,
+			4 * sizeof(int)) != 0)
+		return;
+	if (binReserve((void **)&binIDs, &binIDCap, binTriNum + 1, sizeof(int))
+			!= 0)
+		return;
+	binIDs[binTriNum] = triID;
+	binVaryDim = varyDim;
+	double *vary = &binVarys[binTriNum * 3 * varyDim];
+	vecCopy(varyDim, a, vary);
+	vecCopy(varyDim, b, vary + varyDim);
+	vecCopy(varyDim, c, vary + 2 * varyDim);
+	int *range = &binRanges[binTriNum * 4];
+	range[0] = (int)fmax(xLow, clip[0]) / binTILESIZE;
+	range[1] = (int)fmax(yLow, clip[1]) / binTILESIZE;
+	range[2] = (int)fmin(xHigh, clip[2]) / binTILESIZE;
+	range[3] = (int)fmin(yHigh, clip[3]) / binTILESIZE;
+	binTriNum += 1;
+}
+
+/* Rasterizes the triangles stored by binTriangle on all of the threads, waits
+for them to finish, and empties the bins. */
+void binFlush(
+		const shaShading *sha, depthBuffer *buf, const double unif[],
+		const texTexture *tex[]) {
+	int tileNum, refNum, t, col, row;
+	if (binTriNum == 0)
+		return;
+	traceBegin("binFlush");
+	binTileColNum = (buf->width + binTILESIZE - 1) / binTILESIZE;
+	binTileRowNum = (buf->height + binTILESIZE - 1) / binTILESIZE;
+	tileNum = binTileColNum * binTileRowNum;
+	/* Count the triangles in each tile, and then list them in order. */
+	if (binReserve((void **)&binStarts, &binTileCap, tileNum + 1, sizeof(int))
+			!= 0) {
+		binTriNum = 0;
+		traceEnd();
+		return;
+	}
+	memset(binStarts, 0, (tileNum + 1) * sizeof(int));
+	for (t = 0; t < binTriNum; t += 1) {
+		const int *range = &binRanges[t * 4];
+		for (row = range[1]; row <= range[3]; row += 1)
+			for (col = range[0]; col <= range[2]; col += 1)
+				binStarts[col + binTileColNum * row + 1] += 1;
+	}
+	for (t = 0; t < tileNum; t += 1)
+		binStarts[t + 1] += binStarts[t];
+	refNum = binStarts[tileNum];
+	if (binReserve((void **)&binTris, &binRefCap, refNum, sizeof(int)) != 0) {
+		binTriNum = 0;
+		traceEnd();
+		return;
+	}
+	for (t = 0; t < binTriNum; t += 1) {
+		const int *range = &binRanges[t * 4];
+		for (row = range[1]; row <= range[3]; row += 1)
+			for (col = range[0]; col <= range[2]; col += 1)
+				binTris[binStarts[col + binTileColNum * row]++] = t;
+	}
+	/* Filling the lists has advanced each start to the next tile's start. */
+	for (t = tileNum; t > 0; t -= 1)
+		binStarts[t] = binStarts[t - 1];
+	binStarts[0] = 0;
+	/* Choose the block kernels before the threads race to do it. */
+	if (triCoverBlock == NULL)
+		triSetSIMD(1);
+	binSha = sha;
+	binBuf = buf;
+	binUnif = unif;
+	binTex = tex;
+	triGetClip(buf->width, buf->height, binClip);
+	binRun(binRenderTile, tileNum);
+	binTriNum = 0;
+	traceEnd();
+}
+
+
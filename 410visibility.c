@@ -0,0 +1,86 @@
+
+
+
+/* A visibility buffer records, at each pixel, which triangle is visible there
+and where the pixel lies on that triangle, as its barycentric coordinates beta
+and gamma with respect to the triangle's vertices b and c. Rendering into it
+with triSetPass(triPASSVISIBILITY) does no fragment shading at all. Afterward,
+420deferred.c shades each pixel exactly once, from the recorded triangles. */
+
+/* Feel free to read the struct's members, but don't write them, except through
+the accessors below such as visSet, etc. */
+typedef struct visBuffer visBuffer;
+struct visBuffer {
+	int width, height;
+	int *ids;			/* width * height triangle IDs, or -1 for none */
+	double *barys;		/* width * height pairs of beta, gamma */
+};
+
+/* Initializes a visibility buffer. When you are finished with the buffer, you
+must call visFinalize to deallocate its backing resources. */
+int visInitialize(visBuffer *vis, int width, int height) {
+	vis->ids = (int *)malloc(width * height * sizeof(int));
+	vis->barys = (double *)malloc(width * height * 2 * sizeof(double));
+	if (vis->ids == NULL || vis->barys == NULL) {
+		free(vis->ids);
+		free(vis->barys);
+		vis->ids = NULL;
+		return 1;
+	}
+	vis->width = width;
+	vis->height = height;
+	return 0;
+}
+
+/* Deallocates the resources backing the buffer. */
+void visFinalize(visBuffer *vis) {
+	free(vis->ids);
+	free(vis->barys);
+}
+
+/* Makes every pixel show no triangle. */
+void visClear(visBuffer *vis) {
+	int k;
+	for (k = 0; k < vis->width * vis->height; k += 1)
+		vis->ids[k] = -1;
+}
+
+/* Makes every pixel (i, j) with i0 <= i <= i1 and j0 <= j <= j1 show no 
+triangle. The rectangle is clipped to the buffer. */
+void visClearRect(visBuffer *vis, int i0, int j0, int i1, int j1) {
+	int i, j;
+	i0 = (i0 < 0) ? 0 : i0;
+	j0 = (j0 < 0) ? 0 : j0;
+	i1 = (i1 > vis->width - 1) ? vis->width - 1 : i1;
+	j1 = (j1 > vis->height - 1) ? vis->height - 1 : j1;
+	for (j = j0; j <= j1; j += 1)
+		for (i = i0; i <= i1; i += 1)
+			vis->ids[i + vis->width * j] = -1;
+}
+
+/* Records that the triangle with the given ID is visible at pixel (i, j), with
+barycentric coordinates beta and gamma there. An ID of -1 records that no
+triangle needs shading there. */
+void visSet(visBuffer *vis, int i, int j, int id, double beta, double gamma) {
+	if (0 <= i && i < vis->width && 0 <= j && j < vis->height) {
+		vis->ids[i + vis->width * j] = id;
+		vis->barys[(i + vis->width * j) * 2] = beta;
+		vis->barys[(i + vis->width * j) * 2 + 1] = gamma;
+	}
+}
+
+/* Returns the ID of the triangle visible at pixel (i, j), or -1 if none. */
+int visGetID(const visBuffer *vis, int i, int j) {
+	if (0 <= i && i < vis->width && 0 <= j && j < vis->height)
+		return vis->ids[i + vis->width * j];
+	else
+		return -1;
+}
+
+/* Returns a pointer to the barycentric coordinates beta, gamma at pixel
+(i, j), which must lie within the buffer. */
+const double *visGetBarycentrics(const visBuffer *vis, int i, int j) {
+	return &vis->barys[(i + vis->width * j) * 2];
+}
+
+
@@ -0,0 +1,197 @@
+
+
+
+/* This file shades a frame through a visibility buffer (see 410visibility.c),
+in two passes. defBegin starts the frame. Then meshRender works as usual,
+except that fragment shading is put off: each triangle is recorded, with its
+varyings and its shading, and each pixel records only which triangle is
+visible there and where. Finally defEnd shades each covered pixel exactly once,
+so the cost of shading depends on neither the overdraw nor the sizes of the
+triangles. It walks the buffer in binTILESIZE x binTILESIZE tiles, on the
+threads of 400bin.c, and shades each run of neighboring pixels that show the
+same triangle in one call to shaShadeFragments. If there is a scissor
+rectangle (see triSetScissor), then both passes stay within it, so it must not
+change between defBegin and defEnd.
+
+Only shader programs that pass their depth through (see depthVary in
+260shading.c) are deferred, because the depth test must happen without
+shading. Others are shaded as they are rasterized. The uniforms are copied as
+each mesh is rendered, so the caller may change them before defEnd. */
+
+/* The shading of a mesh. Its uniforms are at defUnifs[unifOffset]. */
+typedef struct defDrawing defDrawing;
+struct defDrawing {
+	const shaShading *sha;
+	const texTexture **tex;
+	int unifOffset;
+};
+
+visBuffer *defVis = NULL;
+int defClip[4];
+defDrawing *defDrawings = NULL;
+double *defUnifs = NULL, *defVarys = NULL;
+int defDrawingNum = 0, defDrawingCap = 0, defUnifNum = 0, defUnifCap = 0;
+/* Whether the shading of the current mesh was recorded. If not, its triangles
+are shaded as they are rasterized. */
+int defMeshRecorded = 0;
+int defVaryNum = 0, defVaryCap = 0;
+
+/* The triangle with ID t has its varyings at defVarys[defTriOffsets[t]], and
+the shading defDrawings[defTriDrawings[t]]. */
+int *defTriOffsets = NULL, *defTriDrawings = NULL;
+int defTriNum = 0, defTriOffsetCap = 0, defTriDrawingCap = 0;
+
+/* Starts a deferred frame, which renders into the given visibility buffer. */
+void defBegin(visBuffer *vis) {
+	triGetClip(vis->width, vis->height, defClip);
+	visClearRect(vis, defClip[0], defClip[1], defClip[2], defClip[3]);
+	defVis = vis;
+	defDrawingNum = 0;
+	defUnifNum = 0;
+	defVaryNum = 0;
+	defTriNum = 0;
+	defMeshRecorded = 0;
+	triSetVisibility(vis);
+	triSetPass(triPASSVISIBILITY);
+}
+
+/* Records the shading of the mesh that meshRender is about to render. If the
+memory runs out, then the mesh is shaded as it is rasterized instead. */
+void defMesh(
+		const shaShading *sha, const double unif[], const texTexture *tex[]) {
+	defMeshRecorded = 0;
+	if (binReserve((void **)&defDrawings, &defDrawingCap, defDrawingNum + 1,
+			sizeof(defDrawing)) != 0)
+		return;
+	if (binReserve((void **)&defUnifs, &defUnifCap, defUnifNum + sha->unifDim,
+			sizeof(double)) != 0)
+		return;
+	defDrawing *drawing = &defDrawings[defDrawingNum];
+	drawing->sha = sha;
+	drawing->tex = tex;
+	drawing->unifOffset = defUnifNum;
+	vecCopy(sha->unifDim, unif, &defUnifs[defUnifNum]);
+	defUnifNum += sha->unifDim;
+	defDrawingNum += 1;
+	defMeshRecorded = 1;
+}
+
+/* Records the triangle abc of the current mesh, whose varyings have been
+through the viewport transformation, and makes its ID the one that the
+rasterizer records. */
+void defTriangle(
+		const shaShading *sha, const double a[], const double b[],
+		const double c[]) {
+	int varyDim = sha->varyDim;
+	triSetID(-1);
+	if (sha->depthVary <= 0 || !defMeshRecorded)
+		return;
+	if (binReserve((void **)&defVarys, &defVaryCap, defVaryNum + 3 * varyDim,
+			sizeof(double)) != 0)
+		return;
+	if (binReserve((void **)&defTriOffsets, &defTriOffsetCap, defTriNum + 1,
+			sizeof(int)) != 0)
+		return;
+	if (binReserve((void **)&defTriDrawings, &defTriDrawingCap, defTriNum + 1,
+			sizeof(int)) != 0)
+		return;
+	vecCopy(varyDim, a, &defVarys[defVaryNum]);
+	vecCopy(varyDim, b, &defVarys[defVaryNum + varyDim]);
+	vecCopy(varyDim, c, &defVarys[defVaryNum + 2 * varyDim]);
+	defTriOffsets[defTriNum] = defVaryNum;
+	defTriDrawings[defTriNum] = defDrawingNum - 1;
+	defVaryNum += 3 * varyDim;
+	triSetID(defTriNum);
+	defTriNum += 1;
+}
+
+/* Shades the n pixels starting at (i, j), which all show triangle id. */
+void defShadeRun(int id, int i, int j, int n) {
+	const defDrawing *drawing = &defDrawings[defTriDrawings[id]];
+	const shaShading *sha = drawing->sha;
+	int varyDim = sha->varyDim, k, m;
+	const double *a = &defVarys[defTriOffsets[id]];
+	const double *b = a + varyDim, *c = b + varyDim;
+	const double *bary = visGetBarycentrics(defVis, i, j);
+	double varys[varyDim * n], rgbds[4 * n];
+	for (m = 0; m < varyDim; m += 1)
+		for (k = 0; k < n; k += 1)
+			varys[m * n + k] = a[m] + (b[m] - a[m]) * bary[2 * k] +
+				(c[m] - a[m]) * bary[2 * k + 1];
+	shaShadeFragments(sha, &defUnifs[drawing->unifOffset], drawing->tex, n,
+		varys, rgbds);
+	for (k = 0; k < n; k += 1)
+		pixSetRGB(i + k, j, rgbds[k], rgbds[n + k], rgbds[2 * n + k]);
+	statCount(statSHADED, n);
+	statCount(statWRITTEN, n);
+	if (triHeat != NULL)
+		for (k = 0; k < n; k += 1) {
+			heatCount(triHeat, heatSHADED, i + k, j, 1);
+			heatCount(triHeat, heatWRITTEN, i + k, j, 1);
+		}
+}
+
+/* Shades the pixels of the given tile of the visibility buffer. */
+void defShadeTile(int tile) {
+	int colNum = (defVis->width + binTILESIZE - 1) / binTILESIZE;
+	int i0 = (tile % colNum) * binTILESIZE, j0 = (tile / colNum) * binTILESIZE;
+	int i1 = (i0 + binTILESIZE - 1 < defClip[2]) ? i0 + binTILESIZE - 1 :
+		defClip[2];
+	int j1 = (j0 + binTILESIZE - 1 < defClip[3]) ? j0 + binTILESIZE - 1 :
+		defClip[3];
+	int i, j, n, id;
+	i0 = (i0 < defClip[0]) ? defClip[0] : i0;
+	j0 = (j0 < defClip[1]) ? defClip[1] : j0;
+	statBegin(statFRAGMENT);
+	for (j = j0; j <= j1; j += 1) {
+		const int *ids = &defVis->ids[defVis->width * j];
+		i = i0;
+		while (i <= i1) {
+			id = ids[i];
+			n = 1;
+			while (i + n <= i1 && ids[i + n] == id)
+				n += 1;
+			if (id >= 0)
+				defShadeRun(id, i, j, n);
+			i += n;
+		}
+	}
+	statEnd(statFRAGMENT);
+}
+
+/* Ends the deferred frame, by shading every pixel that shows a deferred
+triangle. Then rendering returns to triPASSSINGLE. */
+void defEnd(void) {
+	triSetPass(triPASSSINGLE);
+	triSetVisibility(NULL);
+	triSetID(-1);
+	if (defVis == NULL)
+		return;
+	traceBegin("defEnd");
+	int colNum = (defVis->width + binTILESIZE - 1) / binTILESIZE;
+	int rowNum = (defVis->height + binTILESIZE - 1) / binTILESIZE;
+	binRun(defShadeTile, colNum * rowNum);
+	defVis = NULL;
+	traceEnd();
+}
+
+/* Deallocates the memory used to record triangles. */
+void defFinalize(void) {
+	free(defDrawings);
+	free(defUnifs);
+	free(defVarys);
+	free(defTriOffsets);
+	free(defTriDrawings);
+	defDrawings = NULL;
+	defUnifs = NULL;
+	defVarys = NULL;
+	defTriOffsets = NULL;
+	defTriDrawings = NULL;
+	defDrawingCap = 0;
+	defUnifCap = 0;
+	defVaryCap = 0;
+	defTriOffsetCap = 0;
+	defTriDrawingCap = 0;
+}
+
+
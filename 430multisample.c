@@ -0,0 +1,280 @@
+
+
+
+/* A multisample buffer holds the colors of msSAMPLENUM coverage samples per
+pixel, for antialiasing. With triSetMultisample and a depth buffer made by
+depthInitializeMultisample, the rasterizer tests coverage and depth at each
+sample, but runs the fragment shader only once per pixel, and stores its color
+in every sample that the triangle covers and that passes the depth test. Then
+msResolve averages the samples of each pixel into the window. So the edges of
+triangles are smooth, at a quarter of the shading cost of drawing the window at
+twice the resolution each way.
+
+The samples of pixel (i, j) sit at (i, j) plus the offsets in msOffsets, in a
+rotated grid, so that nearly horizontal and nearly vertical edges each get four
+distinct steps. Sample s of every pixel is stored in plane s, which is laid
+out as the window is, with three doubles per pixel. So a resolve is a sum of
+four contiguous rows, which the AVX2 kernel does four doubles at a time.
+
+Clearing is lazy, as in 260depth.c and 040pixelHeadless.c. msClear increments
+the buffer's epoch, and a tile behind the epoch reads as the clear color until
+a sample is written to it. Every write marks its msTILESIZE x msTILESIZE tile
+as dirty, and msResolve touches only the dirty tiles, writing a stale tile with
+the clear color directly. So a frame pays only for the tiles that it touches.
+To resolve once per frame, just before presentation, register a function that
+calls msResolve with pixSetPresentHandler, where 040pixelHeadless.c is in use.
+
+msTILESIZE divides binTILESIZE, so that threads drawing different bins of
+400bin.c never write the same tile. */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define msAVX2 1
+#endif
+
+#define msSAMPLENUM 4
+#define msTILESIZE 32
+
+const double msOffsets[msSAMPLENUM][2] = {
+	{-0.125, -0.375}, {0.375, -0.125}, {-0.375, 0.125}, {0.125, 0.375}};
+
+/* Feel free to read the struct's members, but don't write them, except through
+the accessors below such as msSetSamples, etc. */
+typedef struct msBuffer msBuffer;
+struct msBuffer {
+	int width, height;
+	double *colors;			/* msSAMPLENUM planes of width * height * 3 */
+	int tileColNum, tileRowNum;
+	unsigned int *tileEpochs;	/* tileColNum * tileRowNum epochs */
+	unsigned char *dirty;		/* tileColNum * tileRowNum flags */
+	unsigned int epoch;
+	double clearRGB[3];
+};
+
+/* Initializes a multisample buffer, with every sample black. When you are
+finished with the buffer, you must call msFinalize to deallocate its backing
+resources. */
+int msInitialize(msBuffer *ms, int width, int height) {
+	ms->tileColNum = (width + msTILESIZE - 1) / msTILESIZE;
+	ms->tileRowNum = (height + msTILESIZE - 1) / msTILESIZE;
+	ms->colors = (double *)malloc(
+		(size_t)msSAMPLENUM * width * height * 3 * sizeof(double));
+	ms->tileEpochs = (unsigned int *)calloc(
+		(size_t)ms->tileColNum * ms->tileRowNum, sizeof(unsigned int));
+	ms->dirty = (unsigned char *)calloc(
+		(size_t)ms->tileColNum * ms->tileRowNum, 1);
+	if (ms->colors == NULL || ms->tileEpochs == NULL || ms->dirty == NULL) {
+		free(ms->colors);
+		free(ms->tileEpochs);
+		free(ms->dirty);
+		ms->colors = NULL;
+		ms->tileEpochs = NULL;
+		ms->dirty = NULL;
+		return 1;
+	}
+	ms->width = width;
+	ms->height = height;
+	/* Every tile starts stale, at epoch 0, and reads as the clear color. */
+	ms->epoch = 1;
+	ms->clearRGB[0] = 0.0;
+	ms->clearRGB[1] = 0.0;
+	ms->clearRGB[2] = 0.0;
+	return 0;
+}
+
+/* Deallocates the resources backing the buffer. */
+void msFinalize(msBuffer *ms) {
+	free(ms->colors);
+	free(ms->tileEpochs);
+	free(ms->dirty);
+}
+
+/* Sets every sample to the given color. The cost does not depend on the size
+of the buffer, until msResolve writes the color into the window. */
+void msClear(msBuffer *ms, double red, double green, double blue) {
+	int tile;
+	ms->clearRGB[0] = red;
+	ms->clearRGB[1] = green;
+	ms->clearRGB[2] = blue;
+	ms->epoch += 1;
+	if (ms->epoch == 0) {
+		/* The epoch has wrapped around. Make every tile stale again. */
+		for (tile = 0; tile < ms->tileColNum * ms->tileRowNum; tile += 1)
+			ms->tileEpochs[tile] = 0;
+		ms->epoch = 1;
+	}
+	for (tile = 0; tile < ms->tileColNum * ms->tileRowNum; tile += 1)
+		ms->dirty[tile] = 1;
+}
+
+/* Returns the index of the tile containing pixel (i, j). */
+int msTile(const msBuffer *ms, int i, int j) {
+	return i / msTILESIZE + ms->tileColNum * (j / msTILESIZE);
+}
+
+/* If the given tile is stale, then fills its samples with the clear color, so
+that they can be written. */
+void msRealizeTile(msBuffer *ms, int tile) {
+	if (ms->tileEpochs[tile] == ms->epoch)
+		return;
+	int i0 = (tile % ms->tileColNum) * msTILESIZE;
+	int j0 = (tile / ms->tileColNum) * msTILESIZE;
+	int i1 = (i0 + msTILESIZE < ms->width) ? i0 + msTILESIZE : ms->width;
+	int j1 = (j0 + msTILESIZE < ms->height) ? j0 + msTILESIZE : ms->height;
+	int i, j, s;
+	for (s = 0; s < msSAMPLENUM; s += 1) {
+		double *plane = &ms->colors[(size_t)s * ms->width * ms->height * 3];
+		for (j = j0; j < j1; j += 1)
+			for (i = i0; i < i1; i += 1)
+				vecCopy(3, ms->clearRGB, 
+					&plane[(i + (size_t)ms->width * j) * 3]);
+	}
+	ms->tileEpochs[tile] = ms->epoch;
+}
+
+/* Returns a pointer to the color of sample s of pixel (i, j), which must lie
+within the buffer. */
+double *msGetSample(msBuffer *ms, int i, int j, int s) {
+	return &ms->colors[((size_t)s * ms->width * ms->height + i +
+		(size_t)ms->width * j) * 3];
+}
+
+/* Sets the samples of pixel (i, j) whose bits are set in mask to the given
+color. Bit s stands for sample s. */
+void msSetSamples(msBuffer *ms, int i, int j, int mask, const double rgb[3]) {
+	int s, tile;
+	if (0 <= i && i < ms->width && 0 <= j && j < ms->height) {
+		tile = msTile(ms, i, j);
+		msRealizeTile(ms, tile);
+		for (s = 0; s < msSAMPLENUM; s += 1)
+			if (mask & (1 << s))
+				vecCopy(3, rgb, msGetSample(ms, i, j, s));
+		ms->dirty[tile] = 1;
+	}
+}
+
+/* Sets every sample of the pixels (i, j) with i0 <= i <= i1 and j0 <= j <= j1
+to the given color. The rectangle is clipped to the buffer. Unlike msClear,
+this function is not lazy, but its cost depends only on the tiles that the
+rectangle touches. */
+void msClearRect(
+		msBuffer *ms, int i0, int j0, int i1, int j1, double red, double green,
+		double blue) {
+	const double rgb[3] = {red, green, blue};
+	int i, j, s, col, row;
+	i0 = (i0 < 0) ? 0 : i0;
+	j0 = (j0 < 0) ? 0 : j0;
+	i1 = (i1 > ms->width - 1) ? ms->width - 1 : i1;
+	j1 = (j1 > ms->height - 1) ? ms->height - 1 : j1;
+	if (i0 > i1 || j0 > j1)
+		return;
+	for (row = j0 / msTILESIZE; row <= j1 / msTILESIZE; row += 1)
+		for (col = i0 / msTILESIZE; col <= i1 / msTILESIZE; col += 1) {
+			msRealizeTile(ms, col + ms->tileColNum * row);
+			ms->dirty[col + ms->tileColNum * row] = 1;
+		}
+	for (s = 0; s < msSAMPLENUM; s += 1)
+		for (j = j0; j <= j1; j += 1)
+			for (i = i0; i <= i1; i += 1)
+				vecCopy(3, rgb, msGetSample(ms, i, j, s));
+}
+
+/* Sets avg[k] to the mean of the four planes at k, for 0 <= k < n. The sum is
+taken in the same order in both kernels, so they agree exactly. */
+void msAverageScalar(
+		int n, const double *p0, const double *p1, const double *p2,
+		const double *p3, double avg[]) {
+	int k;
+	for (k = 0; k < n; k += 1)
+		avg[k] = (((p0[k] + p1[k]) + p2[k]) + p3[k]) * 0.25;
+}
+
+#ifdef msAVX2
+__attribute__((target("avx2")))
+void msAverageAVX2(
+		int n, const double *p0, const double *p1, const double *p2,
+		const double *p3, double avg[]) {
+	__m256d quarter = _mm256_set1_pd(0.25);
+	int k;
+	for (k = 0; k + 4 <= n; k += 4) {
+		__m256d sum = _mm256_add_pd(_mm256_loadu_pd(p0 + k),
+			_mm256_loadu_pd(p1 + k));
+		sum = _mm256_add_pd(sum, _mm256_loadu_pd(p2 + k));
+		sum = _mm256_add_pd(sum, _mm256_loadu_pd(p3 + k));
+		_mm256_storeu_pd(avg + k, _mm256_mul_pd(sum, quarter));
+	}
+	msAverageScalar(n - k, p0 + k, p1 + k, p2 + k, p3 + k, avg + k);
+}
+#endif
+
+void (*msAverage)(int, const double *, const double *, const double *,
+	const double *, double *) = NULL;
+
+/* Writes pixels x0 through x1 of row y, with rgb as in pixSetRGBSpan. */
+void msWriteRowPixels(int x0, int x1, int y, const double rgb[]) {
+	int x;
+	for (x = x0; x <= x1; x += 1)
+		pixSetRGB(x, y, rgb[(x - x0) * 3], rgb[(x - x0) * 3 + 1],
+			rgb[(x - x0) * 3 + 2]);
+}
+
+void (*msWriteRow)(int, int, int, const double *) = msWriteRowPixels;
+
+/* Chooses the resolve kernel. If useSIMD is nonzero and the processor supports
+AVX2, then the AVX2 kernel is used, and otherwise the scalar one. Returns
+whether the AVX2 kernel is in use. */
+int msSetSIMD(int useSIMD) {
+	msAverage = msAverageScalar;
+#ifdef msAVX2
+	if (useSIMD && __builtin_cpu_supports("avx2")) {
+		msAverage = msAverageAVX2;
+		return 1;
+	}
+#endif
+	return 0;
+}
+
+/* Sets the function that msResolve uses to write a row of pixels into the
+window. By default it calls pixSetRGB once per pixel, which works with any
+pixel system. Where 040pixelHeadless.c is in use, pass pixSetRGBSpan, which
+copies the whole row at once. */
+void msSetRowWriter(void (*writer)(int, int, int, const double *)) {
+	msWriteRow = (writer == NULL) ? msWriteRowPixels : writer;
+}
+
+/* Writes the mean of the samples of each pixel of the dirty tiles into the
+window, and marks every tile clean. */
+void msResolve(msBuffer *ms) {
+	size_t plane = (size_t)ms->width * ms->height * 3;
+	int tile, i0, i1, j0, j1, j, k;
+	double row[msTILESIZE * 3];
+	if (msAverage == NULL)
+		msSetSIMD(1);
+	traceBegin("msResolve");
+	for (tile = 0; tile < ms->tileColNum * ms->tileRowNum; tile += 1) {
+		if (!ms->dirty[tile])
+			continue;
+		i0 = (tile % ms->tileColNum) * msTILESIZE;
+		j0 = (tile / ms->tileColNum) * msTILESIZE;
+		i1 = (i0 + msTILESIZE < ms->width) ? i0 + msTILESIZE - 1 :
+			ms->width - 1;
+		j1 = (j0 + msTILESIZE < ms->height) ? j0 + msTILESIZE - 1 :
+			ms->height - 1;
+		if (ms->tileEpochs[tile] != ms->epoch) {
+			for (k = 0; k <= i1 - i0; k += 1)
+				vecCopy(3, ms->clearRGB, &row[k * 3]);
+			for (j = j0; j <= j1; j += 1)
+				msWriteRow(i0, i1, j, row);
+		} else
+			for (j = j0; j <= j1; j += 1) {
+				const double *p = msGetSample(ms, i0, j, 0);
+				msAverage((i1 - i0 + 1) * 3, p, p + plane, p + 2 * plane,
+					p + 3 * plane, row);
+				msWriteRow(i0, i1, j, row);
+			}
+		ms->dirty[tile] = 0;
+	}
+	traceEnd();
+}
+
+
@@ -0,0 +1,127 @@
+
+
+
+/* A heat buffer counts, at each pixel, the fragments that the rasterizer
+shades, the fragments that fail the depth test, and the fragments that are
+written. With triSetHeatMap, triRender and the deferred shading of
+420deferred.c count every fragment that they handle, without touching the
+shaders. Then heatShow replaces the window with a false-color image of one of
+the counts, and heatGetHistogram and heatGetTotal summarize it. So a scene's
+overdraw, and its wasted shading, can be seen at a glance: a pixel that was
+shaded many times but written once is fill rate thrown away.
+
+The counts accumulate until heatClear, which is typically called once per
+frame. Threads of 400bin.c count their own tiles, so the counts need no locks.
+*/
+
+#define heatSHADED 0
+#define heatREJECTED 1
+#define heatWRITTEN 2
+#define heatKINDNUM 3
+
+/* Feel free to read the struct's members, but don't write them, except through
+the accessors below such as heatCount, etc. */
+typedef struct heatBuffer heatBuffer;
+struct heatBuffer {
+	int width, height;
+	unsigned int *counts;	/* width * height * heatKINDNUM counts */
+};
+
+/* Initializes a heat buffer, with every count 0. When you are finished with
+the buffer, you must call heatFinalize to deallocate its backing resources. */
+int heatInitialize(heatBuffer *heat, int width, int height) {
+	heat->counts = (unsigned int *)calloc(
+		width * height * heatKINDNUM, sizeof(unsigned int));
+	if (heat->counts == NULL)
+		return 1;
+	heat->width = width;
+	heat->height = height;
+	return 0;
+}
+
+/* Deallocates the resources backing the buffer. */
+void heatFinalize(heatBuffer *heat) {
+	free(heat->counts);
+}
+
+/* Sets every count to 0. */
+void heatClear(heatBuffer *heat) {
+	int k;
+	for (k = 0; k < heat->width * heat->height * heatKINDNUM; k += 1)
+		heat->counts[k] = 0;
+}
+
+/* Adds n to the count of the given kind at pixel (i, j). */
+void heatCount(heatBuffer *heat, int kind, int i, int j, int n) {
+	if (0 <= i && i < heat->width && 0 <= j && j < heat->height)
+		heat->counts[(i + heat->width * j) * heatKINDNUM + kind] += n;
+}
+
+/* Returns the count of the given kind at pixel (i, j). */
+unsigned int heatGetCount(const heatBuffer *heat, int kind, int i, int j) {
+	if (0 <= i && i < heat->width && 0 <= j && j < heat->height)
+		return heat->counts[(i + heat->width * j) * heatKINDNUM + kind];
+	else
+		return 0;
+}
+
+/* Returns the sum of the counts of the given kind over all pixels. */
+long heatGetTotal(const heatBuffer *heat, int kind) {
+	long total = 0;
+	int k;
+	for (k = 0; k < heat->width * heat->height; k += 1)
+		total += heat->counts[k * heatKINDNUM + kind];
+	return total;
+}
+
+/* Sets bins[n] to the number of pixels whose count of the given kind is n, for
+0 <= n < binNum - 1, and bins[binNum - 1] to the number whose count is at least
+binNum - 1. Does nothing if binNum is not positive. */
+void heatGetHistogram(const heatBuffer *heat, int kind, int binNum, long bins[]) {
+	unsigned int count;
+	int k;
+	if (binNum <= 0)
+		return;
+	for (k = 0; k < binNum; k += 1)
+		bins[k] = 0;
+	for (k = 0; k < heat->width * heat->height; k += 1) {
+		count = heat->counts[k * heatKINDNUM + kind];
+		bins[(count < (unsigned int)(binNum - 1)) ? (int)count : binNum - 1] += 1;
+	}
+}
+
+/* Sets rgb to the false color of a count, on a scale that reaches red at
+maxCount: black for 0, then blue, cyan, green, yellow, and red. */
+void heatColor(unsigned int count, unsigned int maxCount, double rgb[3]) {
+	const double ramp[5][3] = {
+		{0.0, 0.0, 1.0}, {0.0, 1.0, 1.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0},
+		{1.0, 0.0, 0.0}};
+	double t;
+	int k, m;
+	if (count == 0) {
+		rgb[0] = rgb[1] = rgb[2] = 0.0;
+		return;
+	}
+	/* Count 1 is blue, and maxCount and above are red. */
+	t = (maxCount <= 1) ? 4.0 : 4.0 * (count - 1.0) / (maxCount - 1.0);
+	if (t >= 4.0)
+		t = 4.0;
+	k = (t >= 4.0) ? 3 : (int)t;
+	t -= k;
+	for (m = 0; m < 3; m += 1)
+		rgb[m] = ramp[k][m] + (ramp[k + 1][m] - ramp[k][m]) * t;
+}
+
+/* Replaces every pixel of the window with the false color of its count of the
+given kind, on a scale that reaches red at maxCount. */
+void heatShow(const heatBuffer *heat, int kind, unsigned int maxCount) {
+	double rgb[3];
+	int i, j;
+	for (j = 0; j < heat->height; j += 1)
+		for (i = 0; i < heat->width; i += 1) {
+			heatColor(heatGetCount(heat, kind, i, j), maxCount, rgb);
+			pixSetRGB(i, j, rgb[0], rgb[1], rgb[2]);
+		}
+}
+
+